@@ -0,0 +1,137 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+#include <algorithm>
+#include <functional>
+
+#include "random_stream.h"
+
+// entity storage, structure of arrays
+// every kind of thing (ghosts, food...) gets one store, and each field is its own contiguous array, so a system
+// that only needs positions and velocities runs through exactly those and nothing else. the systems below
+// update a whole store in one loop instead of calling update() on one object at a time
+
+// where things wrap around the window, per kind since ghosts and food never used quite the same rule
+// going past max lands on wrapTo, going under min lands on max
+struct WrapBounds {
+    float minX, maxX, wrapToX;
+    float minY, maxY, wrapToY;
+};
+
+class EntityStore {
+    public:
+        std::vector<float> x, y;
+        std::vector<float> previousX, previousY; // where they were a tick ago, drawing blends between the two
+        std::vector<float> velocityX, velocityY;
+        std::vector<float> timer; // seconds until the next direction change
+        std::vector<float> radius;
+        std::vector<float> red, green, blue;
+        std::vector<RandomStream> random; // each entity rolls its own numbers
+
+        float speed = 0.0f; // every entity of a kind moves at the same speed
+        WrapBounds bounds = {};
+
+        int size() const {
+            return (int)x.size();
+        }
+
+        int add(float xPos, float yPos, float entityRadius, float r, float g, float b, RandomStream stream) {
+            x.push_back(xPos);
+            y.push_back(yPos);
+            previousX.push_back(xPos);
+            previousY.push_back(yPos);
+            velocityX.push_back(0.0f);
+            velocityY.push_back(0.0f);
+            timer.push_back(0.0f);
+            radius.push_back(entityRadius);
+            red.push_back(r);
+            green.push_back(g);
+            blue.push_back(b);
+            random.push_back(stream);
+            return size() - 1;
+        }
+
+        // marks i for removal, it stays where it is (and keeps getting updated) until flushRemovals
+        // safe to call while something is iterating the store, nothing moves
+        void kill(int i) {
+            pendingRemovals.push_back(i);
+        }
+
+        // removes everything killed since the last flush, call it once at the end of the tick
+        // each one is a swap with the last entity and a pop, so it's O(1) per removal no matter how many die.
+        // this doesn't keep the order, and the entity that got swapped in takes over the dead one's index
+        int flushRemovals() {
+            // highest first, so whatever gets swapped down is never one that's still waiting to be removed
+            std::sort(pendingRemovals.begin(), pendingRemovals.end(), std::greater<int>());
+            pendingRemovals.erase(std::unique(pendingRemovals.begin(), pendingRemovals.end()), pendingRemovals.end());
+
+            for (int i : pendingRemovals) {
+                for (auto field : { &x, &y, &previousX, &previousY, &velocityX, &velocityY, &timer, &radius, &red, &green, &blue }) {
+                    (*field)[i] = field->back();
+                    field->pop_back();
+                }
+                random[i] = random.back();
+                random.pop_back();
+            }
+
+            int removed = (int)pendingRemovals.size();
+            pendingRemovals.clear();
+            return removed;
+        }
+
+    private:
+        std::vector<int> pendingRemovals;
+};
+
+// counts every timer down
+inline void updateTimers(EntityStore& store, float timeDelta) {
+    float* timer = store.timer.data();
+    for (int i = 0; i < store.size(); i++) {
+        timer[i] -= timeDelta;
+    }
+}
+
+// gives every entity whose timer ran out a new direction and timer
+// pick(i, directionX, directionY, duration) decides what they are, so the same loop works for random
+// wandering or anything smarter
+template <typename Pick>
+void pickDirections(EntityStore& store, const Pick& pick) {
+    for (int i = 0; i < store.size(); i++) {
+        if (store.timer[i] > 0) continue;
+
+        float directionX, directionY, duration;
+        pick(i, directionX, directionY, duration);
+        store.velocityX[i] = directionX * store.speed;
+        store.velocityY[i] = directionY * store.speed;
+        store.timer[i] = duration;
+    }
+}
+
+// moves everything along its velocity and wraps it around the window
+// the old position goes into previous, except for things that just wrapped, those jump instead of sliding
+// back across the whole window
+inline void moveEntities(EntityStore& store, float timeDelta) {
+    float* x = store.x.data();
+    float* y = store.y.data();
+    float* previousX = store.previousX.data();
+    float* previousY = store.previousY.data();
+    const float* velocityX = store.velocityX.data();
+    const float* velocityY = store.velocityY.data();
+    const WrapBounds bounds = store.bounds;
+
+    for (int i = 0; i < store.size(); i++) {
+        float newX = x[i] + velocityX[i] * timeDelta;
+        float newY = y[i] + velocityY[i] * timeDelta;
+
+        float movedX = newX, movedY = newY;
+        newX = (newX > bounds.maxX) ? bounds.wrapToX : (newX < bounds.minX) ? bounds.maxX : newX;
+        newY = (newY > bounds.maxY) ? bounds.wrapToY : (newY < bounds.minY) ? bounds.maxY : newY;
+        bool wrapped = (newX != movedX) || (newY != movedY);
+
+        previousX[i] = wrapped ? newX : x[i];
+        previousY[i] = wrapped ? newY : y[i];
+        x[i] = newX;
+        y[i] = newY;
+    }
+}
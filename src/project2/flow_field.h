@@ -0,0 +1,105 @@
+#pragma once
+
+#include <vector>
+#include <chrono>
+#include <cstdint>
+
+#include "maze.h"
+
+// which way to go from every tile to reach one target tile, for any number of chasers at once
+// one breadth first search out from the target fills in every open tile's distance and the neighbor to step
+// to, then a chaser only has to look up the tile it's standing on. the search only reruns when the target moves
+// to another tile, so hundreds of ghosts chasing pacman cost one search every time he crosses a tile edge
+
+class FlowField {
+    private:
+        int columns = 0, rows = 0;
+        int target = -1;
+        std::vector<int> distance;      // steps to the target, -1 where it can't be reached (or a wall)
+        std::vector<int8_t> stepX, stepY; // which neighbor is one step closer, 0 0 on the target itself
+        std::vector<int> queue;
+
+        long rebuildCount = 0;
+        double rebuildSeconds = 0.0;
+
+        void build(const Maze& maze) {
+            auto start = std::chrono::steady_clock::now();
+
+            columns = maze.columns;
+            rows = maze.rows;
+            distance.assign((size_t)maze.cellCount(), -1);
+            stepX.assign((size_t)maze.cellCount(), 0);
+            stepY.assign((size_t)maze.cellCount(), 0);
+            queue.resize((size_t)maze.cellCount());
+
+            const int offsetX[4] = { 1, -1, 0, 0 };
+            const int offsetY[4] = { 0, 0, 1, -1 };
+
+            int head = 0, tail = 0;
+            distance[target] = 0;
+            queue[tail++] = target;
+            while (head < tail) {
+                int cell = queue[head++];
+                int column = cell % columns, row = cell / columns;
+
+                for (int n = 0; n < 4; n++) {
+                    int neighborColumn = column + offsetX[n], neighborRow = row + offsetY[n];
+                    if (maze.isWall(neighborColumn, neighborRow)) continue;
+
+                    int neighbor = neighborRow * columns + neighborColumn;
+                    if (distance[neighbor] >= 0) continue;
+
+                    // we got here from cell, so going back that way is a step towards the target
+                    distance[neighbor] = distance[cell] + 1;
+                    stepX[neighbor] = (int8_t)-offsetX[n];
+                    stepY[neighbor] = (int8_t)-offsetY[n];
+                    queue[tail++] = neighbor;
+                }
+            }
+
+            rebuildCount++;
+            rebuildSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        }
+
+    public:
+        // points the field at a new target tile, only searches again if it's not the one it already has
+        // (or the maze is a different size). true if it did
+        bool update(const Maze& maze, int targetColumn, int targetRow) {
+            int cell = targetRow * maze.columns + targetColumn;
+            if (cell == target && columns == maze.columns && rows == maze.rows) return false;
+            if (maze.isWall(targetColumn, targetRow)) return false; // keep the old field until he's somewhere real
+
+            target = cell;
+            build(maze);
+            return true;
+        }
+
+        // forget the target so the next update always searches (after the maze itself changed)
+        void invalidate() {
+            target = -1;
+        }
+
+        bool reachable(int column, int row) const {
+            return column >= 0 && column < columns && row >= 0 && row < rows && distance[(size_t)row * columns + column] >= 0;
+        }
+
+        int distanceAt(int column, int row) const {
+            return reachable(column, row) ? distance[(size_t)row * columns + column] : -1;
+        }
+
+        // step to take from a tile, in tiles (0 0 on the target or where the target can't be reached)
+        void step(int column, int row, int& x, int& y) const {
+            x = y = 0;
+            if (!reachable(column, row)) return;
+            x = stepX[(size_t)row * columns + column];
+            y = stepY[(size_t)row * columns + column];
+        }
+
+        long rebuilds() const {
+            return rebuildCount;
+        }
+
+        double secondsRebuilding() const {
+            return rebuildSeconds;
+        }
+};
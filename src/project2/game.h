@@ -0,0 +1,370 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cmath>
+#include <iostream>
+#include <algorithm>
+
+#include "entities.h"
+#include "spatial_hash.h"
+#include "random_stream.h"
+#include "maze.h"
+#include "flow_field.h"
+
+// the game itself, everything that decides what happens and nothing that draws it
+// it only ever moves forward in fixed steps of tickDelta, so what happens depends on the seed and the input
+// each tick and nothing else (not the frame rate, not how long a frame took). main.cpp runs as many ticks as
+// real time asks for and draws in between them
+
+// everything about a game's setup that can change between runs
+// (the window shows the whole field, so the window is as big as this says)
+struct GameConfig {
+    int windowWidth = 640;
+    int windowHeight = 480;
+    int windowOffset = 25;
+
+    int numOfFoodObjects = 20;
+    int numOfMonsters = 4;
+    int baseMovementSpeed = 50;
+
+    int tileSize = 32;       // of the maze the ghosts find their way through
+    bool ghostsChase = true; // false for the old random wandering
+
+    std::vector<std::string> mazeLayout; // rows of a maze file (see maze.h), empty for an open field
+
+    int pacmanMovementSpeed() const {
+        return (int)(baseMovementSpeed * 1.25);
+    }
+};
+
+// constants
+const float ghostWidth = 30.0f;
+const float foodRadius = 5.0f;
+
+const int tickRate = 60;
+const float tickDelta = 1.0f / tickRate;
+
+// what's held down during a tick, one bit per key
+enum GameInput {
+    INPUT_UP = 1,    // W
+    INPUT_DOWN = 2,  // S
+    INPUT_LEFT = 4,  // A
+    INPUT_RIGHT = 8  // D
+};
+
+enum GameState {
+    GAME_PLAYING,
+    GAME_WON,
+    GAME_LOST
+};
+
+class PacMan {
+    private:
+        float xPos, yPos;
+        float previousX, previousY;
+
+        float radius = 20.0f;
+        float directionX = 0.0f, directionY = 0.0f;
+
+        WrapBounds bounds;
+
+    public:
+        PacMan(float xPos, float yPos, WrapBounds bounds) : xPos(xPos), yPos(yPos), previousX(xPos), previousY(yPos), bounds(bounds) {};
+
+        float getX() const {
+            return xPos;
+        }
+
+        float getY() const {
+            return yPos;
+        }
+
+        float getPreviousX() const {
+            return previousX;
+        }
+
+        float getPreviousY() const {
+            return previousY;
+        }
+
+        float getRadius() const {
+            return radius;
+        }
+
+        float getDirectionX() const {
+            return directionX;
+        }
+
+        float getDirectionY() const {
+            return directionY;
+        }
+
+        // start of a tick, where he is now is where drawing starts blending from
+        void settle() {
+            previousX = xPos;
+            previousY = yPos;
+        }
+
+        // somewhere else without turning (walls pushing him back)
+        void place(float x, float y) {
+            xPos = x;
+            yPos = y;
+        }
+
+        void move(float x, float y) {
+            xPos += x;
+            yPos += y;
+
+            // keep track of the direction for the mouth animation
+            directionX = 0.0f;
+            directionY = 0.0f;
+
+            if(x > 0) {
+                directionX = 1.0f;
+            } else if (x < 0) {
+                directionX = -1.0f;
+            } else if (y > 0) {
+                directionY = 1.0f;
+            } else if (y < 0) {
+                directionY = -1.0f;
+            }
+
+            // keep pacman within the window bounds (wrapping around)
+            // and don't blend across the window when he does
+            float movedX = xPos, movedY = yPos;
+            xPos = (xPos > bounds.maxX) ? bounds.wrapToX : (xPos < bounds.minX) ? bounds.maxX : xPos;
+            yPos = (yPos > bounds.maxY) ? bounds.wrapToY : (yPos < bounds.minY) ? bounds.maxY : yPos;
+
+            bool wrapped = (xPos != movedX) || (yPos != movedY);
+            if (wrapped) settle();
+        }
+};
+
+// ghosts and food wander the same way: pick a random direction, go that way for a random time, repeat
+// (food moves slower though)
+inline void updateWanderers(EntityStore& store, float timeDelta) {
+    updateTimers(store, timeDelta);
+
+    // if the timer is up, roll a new direction and timer from the entity's own stream
+    pickDirections(store, [&](int i, float& directionX, float& directionY, float& duration) {
+        RandomStream& random = store.random[i];
+        directionX = (float)random.range(-1, 1);
+        directionY = (float)random.range(-1, 1);
+        duration = random.uniform(0.0f, 3.5f);
+    });
+
+    moveEntities(store, timeDelta);
+}
+
+// ghosts that hunt pacman down: each one looks up the tile it's on in the flow field and heads for the middle
+// of the tile it says is next, or straight at pacman once there's no step left to take (same tile, or nowhere
+// the field reaches). they stay inside their wrap bounds, going around the edge would only take them further away
+inline void chasePacMan(EntityStore& ghosts, const Maze& maze, const FlowField& field, float targetX, float targetY, float timeDelta) {
+    const WrapBounds bounds = ghosts.bounds;
+
+    for (int i = 0; i < ghosts.size(); i++) {
+        int column = maze.column(ghosts.x[i]), row = maze.row(ghosts.y[i]);
+        int stepX, stepY;
+        field.step(column, row, stepX, stepY);
+
+        float goalX = targetX, goalY = targetY;
+        if (stepX != 0 || stepY != 0) {
+            goalX = maze.centerX(column + stepX);
+            goalY = maze.centerY(row + stepY);
+        }
+        goalX = std::min(std::max(goalX, bounds.minX), bounds.maxX);
+        goalY = std::min(std::max(goalY, bounds.minY), bounds.maxY);
+
+        float dx = goalX - ghosts.x[i], dy = goalY - ghosts.y[i];
+        float length = std::sqrt(dx * dx + dy * dy);
+
+        // slow down at the goal instead of overshooting it and jittering around it
+        float speed = std::min(ghosts.speed, length / timeDelta);
+        float scale = (length > 0.001f) ? speed / length : 0.0f;
+        ghosts.velocityX[i] = dx * scale;
+        ghosts.velocityY[i] = dy * scale;
+    }
+
+    moveEntities(ghosts, timeDelta);
+}
+
+// pushes everything in a store back out of the maze's walls
+inline void resolveWalls(EntityStore& store, const Maze& maze) {
+    if (maze.wallCount == 0) return;
+
+    for (int i = 0; i < store.size(); i++) {
+        maze.resolveCircle(store.x[i], store.y[i], store.radius[i]);
+    }
+}
+
+// sorts a store into a grid covering the window (everything wraps inside it)
+// cells are never smaller than about one entity each, a handful of food in a big window doesn't need thousands
+// of empty cells cleared every tick
+inline void buildSpatialHash(SpatialHash& hash, const EntityStore& store, const GameConfig& config) {
+    float largestRadius = 0.0f;
+    for (float radius : store.radius) {
+        largestRadius = std::max(largestRadius, radius);
+    }
+
+    float area = (float)config.windowWidth * config.windowHeight;
+    float cellSize = std::max(SpatialHash::cellSizeFor(largestRadius), std::sqrt(area / std::max(store.size(), 1)));
+    hash.build(0.0f, 0.0f, config.windowWidth, config.windowHeight, cellSize, store.size(), store.x.data(), store.y.data(), store.radius.data());
+}
+
+// how much time went into flow field searches
+inline void printFlowFieldTime(long rebuilds, double seconds) {
+    if (rebuilds == 0) return;
+    std::cout << "  flow field: " << rebuilds << " rebuilds, " << seconds * 1000.0 << " ms in all, "
+        << seconds / rebuilds * 1e6 << " us each" << std::endl;
+}
+
+class Game {
+    private:
+        SpatialHash foodHash, ghostHash;
+
+    public:
+        GameConfig config;
+        uint64_t seed;
+        PacMan pacman;
+        EntityStore ghosts, foods;
+
+        Maze maze;
+        FlowField flowField; // towards pacman, for the ghosts
+
+        int score = 0;
+        long ticks = 0;
+        GameState state = GAME_PLAYING;
+
+        // everything about the starting layout comes out of the seed
+        // the layout draws from one stream, then every ghost and food gets its own (numbered in creation order)
+        explicit Game(uint64_t seed, const GameConfig& gameConfig = GameConfig()) : config(gameConfig), seed(seed), pacman(0.0f, 0.0f, WrapBounds()) {
+            const int width = config.windowWidth, height = config.windowHeight, offset = config.windowOffset;
+            RandomStream layout(seed);
+            uint64_t nextEntity = 1;
+
+            float tileSize = (float)std::max(config.tileSize, 1);
+            maze = config.mazeLayout.empty() ? Maze::open((float)width, (float)height, tileSize) : Maze::fromLayout(config.mazeLayout, tileSize);
+
+            // somewhere random that isn't in a wall (with no walls that's just the first roll)
+            auto spawn = [&](float radius, float& x, float& y) {
+                for (int tries = 0; ; tries++) {
+                    x = layout.range(offset, width - offset);
+                    y = layout.range(offset, height - offset);
+                    if (!maze.blocked(x, y, radius) || tries == 1000) break;
+                }
+            };
+
+            // keep pacman within the window bounds (wrapping around)
+            float pacmanX, pacmanY;
+            spawn(pacman.getRadius(), pacmanX, pacmanY);
+            pacman = PacMan(pacmanX, pacmanY, { (float)offset, (float)width, (float)offset,
+                                                (float)offset, (float)height, (float)offset });
+
+            ghosts.speed = config.baseMovementSpeed;
+
+            // keep the ghosts within the window bounds (wrapping around)
+            ghosts.bounds = { (float)offset, (float)width, (float)offset,
+                              (float)offset, (float)(height - offset), (float)offset };
+
+            for (int i = 0; i < config.numOfMonsters; i++) {
+                float r = layout.uniform(0.0f, 1.0f), g = layout.uniform(0.0f, 1.0f), b = layout.uniform(0.0f, 1.0f);
+                float x, y;
+                spawn(ghostWidth / 2.0f, x, y);
+                ghosts.add(x, y, ghostWidth / 2.0f, r, g, b, RandomStream(seed, nextEntity++));
+            }
+
+            foods.speed = (float)(config.baseMovementSpeed / 3);
+
+            // keep the food within the window bounds (wrapping around)
+            foods.bounds = { 0.0f, (float)width, (float)offset,
+                             0.0f, (float)height, (float)offset };
+
+            for (int i = 0; i < config.numOfFoodObjects; i++) {
+                float x, y;
+                spawn(foodRadius, x, y);
+                foods.add(x, y, foodRadius, 255, 105, 180, RandomStream(seed, nextEntity++));
+            }
+        }
+
+        // one step of tickDelta seconds with input (GameInput bits) held down, does nothing once the game is over
+        GameState tick(int input) {
+            if (state != GAME_PLAYING) return state;
+
+            // move pacman
+            pacman.settle();
+            float step = config.pacmanMovementSpeed() * tickDelta;
+            if (input & INPUT_UP) pacman.move(0, -step);
+            if (input & INPUT_DOWN) pacman.move(0, step);
+            if (input & INPUT_LEFT) pacman.move(-step, 0);
+            if (input & INPUT_RIGHT) pacman.move(step, 0);
+
+            // walls stop him, the tile grid says which ones are close enough to matter
+            float pacmanX = pacman.getX(), pacmanY = pacman.getY();
+            if (maze.resolveCircle(pacmanX, pacmanY, pacman.getRadius())) pacman.place(pacmanX, pacmanY);
+
+            // the ghosts' way to pacman only changes when he gets to another tile
+            if (config.ghostsChase) flowField.update(maze, maze.column(pacman.getX()), maze.row(pacman.getY()));
+
+            // sort the food and the ghosts into the grids, then pacman only gets checked against what's near him
+            buildSpatialHash(foodHash, foods, config);
+            buildSpatialHash(ghostHash, ghosts, config);
+
+            // check for collisions between pacman and the food
+            // eaten food only gets marked here and is taken out all at once after the query is done
+            foodHash.query(pacman.getX(), pacman.getY(), pacman.getRadius(), [&](int food) {
+                foods.kill(food);
+                score += 10;
+            });
+            foods.flushRemovals();
+
+            // check for collisions between pacman and the ghosts
+            // isn't perfect since the ghosts are not perfect circles, but who cares
+            bool caught = false;
+            ghostHash.query(pacman.getX(), pacman.getY(), pacman.getRadius(), [&](int) { caught = true; });
+
+            if (caught) {
+                state = GAME_LOST;
+            } else if (foods.size() == 0) {
+                state = GAME_WON; // no food left, we win
+            }
+
+            updateWanderers(foods, tickDelta);
+            if (config.ghostsChase) {
+                chasePacMan(ghosts, maze, flowField, pacman.getX(), pacman.getY(), tickDelta);
+            } else {
+                updateWanderers(ghosts, tickDelta);
+            }
+            resolveWalls(foods, maze);
+            resolveWalls(ghosts, maze);
+
+            ticks++;
+            return state;
+        }
+
+        // fnv-1a over everything that moves, two games that played out the same have the same checksum
+        uint64_t checksum() const {
+            uint64_t h = 14695981039346656037ull;
+            auto mix = [&h](const void* data, size_t size) {
+                const uint8_t* bytes = (const uint8_t*)data;
+                for (size_t i = 0; i < size; i++) {
+                    h ^= bytes[i];
+                    h *= 1099511628211ull;
+                }
+            };
+
+            float pacmanX = pacman.getX(), pacmanY = pacman.getY();
+            mix(&pacmanX, sizeof(pacmanX));
+            mix(&pacmanY, sizeof(pacmanY));
+            mix(&score, sizeof(score));
+            mix(&ticks, sizeof(ticks));
+            mix(&state, sizeof(state));
+            for (const EntityStore* store : { &ghosts, &foods }) {
+                for (const std::vector<float>* field : { &store->x, &store->y, &store->velocityX, &store->velocityY, &store->timer }) {
+                    if (!field->empty()) mix(field->data(), field->size() * sizeof(float));
+                }
+            }
+            return h;
+        }
+};
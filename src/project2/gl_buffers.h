@@ -0,0 +1,58 @@
+#pragma once
+
+#include <GLFW/glfw3.h>
+
+#include <cstddef>
+
+// vertex buffer objects
+// they're opengl 1.5 but windows' opengl32 only exports 1.1, so the functions get looked up at runtime
+// (the glad we have is generated for the core profile, which doesn't have the fixed function client arrays
+// the rest of project2 draws with, so we can't just switch over to it)
+
+#ifndef GL_ARRAY_BUFFER
+    #define GL_ARRAY_BUFFER 0x8892
+#endif
+#ifndef GL_ELEMENT_ARRAY_BUFFER
+    #define GL_ELEMENT_ARRAY_BUFFER 0x8893
+#endif
+#ifndef GL_STATIC_DRAW
+    #define GL_STATIC_DRAW 0x88E4
+#endif
+#ifndef GL_DYNAMIC_DRAW
+    #define GL_DYNAMIC_DRAW 0x88E8
+#endif
+
+#ifdef _WIN32
+    #define GL_BUFFER_CALL __stdcall
+#else
+    #define GL_BUFFER_CALL
+#endif
+
+struct GLBufferFunctions {
+    void (GL_BUFFER_CALL *genBuffers)(GLsizei count, GLuint* buffers) = nullptr;
+    void (GL_BUFFER_CALL *bindBuffer)(GLenum target, GLuint buffer) = nullptr;
+    void (GL_BUFFER_CALL *bufferData)(GLenum target, ptrdiff_t size, const void* data, GLenum usage) = nullptr;
+    void (GL_BUFFER_CALL *bufferSubData)(GLenum target, ptrdiff_t offset, ptrdiff_t size, const void* data) = nullptr;
+    void (GL_BUFFER_CALL *deleteBuffers)(GLsizei count, const GLuint* buffers) = nullptr;
+
+    bool available() const {
+        return genBuffers && bindBuffer && bufferData && bufferSubData && deleteBuffers;
+    }
+};
+
+// looked up the first time it's called, so only call it once there's a current context
+inline const GLBufferFunctions& glBufferFunctions() {
+    static GLBufferFunctions functions;
+    static bool loaded = false;
+
+    if (!loaded) {
+        loaded = true;
+        functions.genBuffers = (decltype(functions.genBuffers))glfwGetProcAddress("glGenBuffers");
+        functions.bindBuffer = (decltype(functions.bindBuffer))glfwGetProcAddress("glBindBuffer");
+        functions.bufferData = (decltype(functions.bufferData))glfwGetProcAddress("glBufferData");
+        functions.bufferSubData = (decltype(functions.bufferSubData))glfwGetProcAddress("glBufferSubData");
+        functions.deleteBuffers = (decltype(functions.deleteBuffers))glfwGetProcAddress("glDeleteBuffers");
+    }
+
+    return functions;
+}
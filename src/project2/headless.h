@@ -0,0 +1,166 @@
+#pragma once
+
+#include <cstdint>
+#include <cctype>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <iostream>
+#include <algorithm>
+
+#include "game.h"
+#include "parallel.h"
+
+// lots of games at once without a window, for trying out controllers
+// every game gets its own seed (the first seed plus its number) and its own controller, and they're spread
+// over a pool of threads. nothing here touches glfw or opengl, the games only ever tick
+
+// what plays pacman
+//   random:   holds one random key (or nothing) for a random 10 - 90 ticks, then rolls again
+//   scripted: plays a fixed list of steps over and over, see parseScript
+enum ControllerKind {
+    CONTROLLER_RANDOM,
+    CONTROLLER_SCRIPTED
+};
+
+struct ScriptStep {
+    int input; // GameInput bits
+    int ticks;
+};
+
+// a script is a list of steps like "D60 WD30 -20": the keys to hold (any of WASD, or - for none) and for
+// how many ticks. separated by spaces or commas. false if it doesn't parse
+inline bool parseScript(const std::string& text, std::vector<ScriptStep>& steps) {
+    steps.clear();
+    size_t i = 0;
+    while (i < text.size()) {
+        if (text[i] == ' ' || text[i] == ',') {
+            i++;
+            continue;
+        }
+
+        ScriptStep step = { 0, 0 };
+        for (; i < text.size() && !std::isdigit((unsigned char)text[i]); i++) {
+            switch (std::toupper((unsigned char)text[i])) {
+                case 'W': step.input |= INPUT_UP; break;
+                case 'S': step.input |= INPUT_DOWN; break;
+                case 'A': step.input |= INPUT_LEFT; break;
+                case 'D': step.input |= INPUT_RIGHT; break;
+                case '-': break;
+                default: return false;
+            }
+        }
+        for (; i < text.size() && std::isdigit((unsigned char)text[i]); i++) {
+            step.ticks = step.ticks * 10 + (text[i] - '0');
+        }
+        if (step.ticks <= 0) return false;
+        steps.push_back(step);
+    }
+    return !steps.empty();
+}
+
+class Controller {
+    private:
+        ControllerKind kind;
+        const std::vector<ScriptStep>* script;
+        RandomStream random;
+
+        int held = 0;
+        int ticksLeft = 0;
+        size_t step = 0;
+
+    public:
+        // the random controller gets a stream of its own, well away from the ones the game hands its entities
+        Controller(ControllerKind kind, const std::vector<ScriptStep>* script, uint64_t seed)
+            : kind(kind), script(script), random(seed, 0xFFFFFFFFull) {}
+
+        // input for the next tick
+        int next(const Game&) {
+            if (ticksLeft == 0) {
+                if (kind == CONTROLLER_SCRIPTED) {
+                    held = (*script)[step].input;
+                    ticksLeft = (*script)[step].ticks;
+                    step = (step + 1) % script->size();
+                } else {
+                    int key = random.range(0, 4);
+                    held = (key == 0) ? 0 : 1 << (key - 1);
+                    ticksLeft = random.range(10, 90);
+                }
+            }
+
+            ticksLeft--;
+            return held;
+        }
+};
+
+struct HeadlessOptions {
+    int games = 1000;
+    uint64_t seed = 0;
+    int threadCount = 1;
+    long maxTicks = 5L * 60 * tickRate; // games that go longer than this (5 minutes) get called off
+    ControllerKind controller = CONTROLLER_RANDOM;
+    std::vector<ScriptStep> script;
+    GameConfig config;
+    bool csv = false; // one line per game as well
+};
+
+struct GameResult {
+    GameState state;
+    int score;
+    long ticks;
+    long flowFieldRebuilds;
+    double flowFieldSeconds;
+};
+
+// plays options.games games to the end and prints how they went and how fast
+inline void runHeadless(const HeadlessOptions& options) {
+    std::vector<GameResult> results(options.games);
+
+    auto start = std::chrono::steady_clock::now();
+    parallelFor(options.games, options.threadCount, [&](int i) {
+        Game game(options.seed + i, options.config);
+        Controller controller(options.controller, &options.script, options.seed + i);
+
+        while (game.ticks < options.maxTicks && game.tick(controller.next(game)) == GAME_PLAYING) {}
+
+        results[i] = { game.state, game.score, game.ticks, game.flowField.rebuilds(), game.flowField.secondsRebuilding() };
+    });
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    if (options.csv) {
+        std::cout << "game,seed,result,score,ticks" << std::endl;
+        for (int i = 0; i < options.games; i++) {
+            const GameResult& result = results[i];
+            std::cout << i << "," << options.seed + i << ","
+                << (result.state == GAME_WON ? "won" : result.state == GAME_LOST ? "lost" : "timeout") << ","
+                << result.score << "," << result.ticks << "\n";
+        }
+    }
+
+    int won = 0, lost = 0;
+    int lowest = 0, highest = 0;
+    double scoreSum = 0.0, tickSum = 0.0;
+    long rebuilds = 0;
+    double rebuildSeconds = 0.0;
+    for (int i = 0; i < options.games; i++) {
+        const GameResult& result = results[i];
+        won += (result.state == GAME_WON);
+        lost += (result.state == GAME_LOST);
+        lowest = (i == 0) ? result.score : std::min(lowest, result.score);
+        highest = (i == 0) ? result.score : std::max(highest, result.score);
+        scoreSum += result.score;
+        tickSum += result.ticks;
+        rebuilds += result.flowFieldRebuilds;
+        rebuildSeconds += result.flowFieldSeconds;
+    }
+
+    int games = std::max(options.games, 1);
+    std::cout << options.games << " games (" << options.config.numOfMonsters << (options.config.ghostsChase ? " chasing" : " wandering") << " ghosts, " << options.config.numOfFoodObjects
+        << " food, " << options.config.windowWidth << "x" << options.config.windowHeight << ") on " << options.threadCount << " threads, "
+        << (options.controller == CONTROLLER_SCRIPTED ? "scripted" : "random") << " controller:" << std::endl;
+    std::cout << "  won " << won << ", lost " << lost << ", out of time " << options.games - won - lost << std::endl;
+    std::cout << "  score: mean " << scoreSum / games << ", min " << lowest << ", max " << highest << std::endl;
+    std::cout << "  " << (long long)tickSum << " ticks (" << tickSum / games << " per game) in " << seconds << " s: "
+        << tickSum / seconds << " ticks/s, " << options.games / seconds << " games/s" << std::endl;
+    printFlowFieldTime(rebuilds, rebuildSeconds);
+}
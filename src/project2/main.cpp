@@ -1,443 +1,427 @@
 #include <GLFW/glfw3.h>
 
+#include <cstdio>
+#include <cstdlib>
+#include <cerrno>
 #include <iostream>
 #include <vector>
 #include <random>
+#include <string>
+#include <chrono>
+#include <algorithm>
+
+#include "game.h"
+#include "headless.h"
+#include "sprite_batch.h"
+#include "recording.h"
+#include "maze_mesh.h"
+
+// how fast pacman's mouth opens and closes
+const float mouthSize = 0.5f;
+const float mouthSpeed = 10.0f;
+
+// at most this much real time gets simulated per frame, so a long stall (dragging the window...) doesn't
+// turn into seconds of catch up ticks
+const double maxFrameTime = 0.25;
+
+// somewhere between where something was last tick and where it is now, alpha from 0 to 1
+float blend(float previous, float current, float alpha) {
+    return previous + (current - previous) * alpha;
+}
 
-// constants
-const int windowWidth = 640;
-const int windowHeight = 480;
-const int windowOffset = 25;
-
-const int numOfFoodObjects = 20;
-const int numOfMonsters = 4;
-const int baseMovementSpeed = 50;
-
-int score = 0;
-
-// random number generator for colors and starting locations
-std::default_random_engine generator;
-
-// gen for colors
-std::uniform_real_distribution<> colorDistributor(0.0,1.0);
-
-// gen for starting locations
-std::uniform_int_distribution<> widthDistribution(0 + windowOffset, windowWidth - windowOffset);
-std::uniform_int_distribution<> heightDistribution(0 + windowOffset, windowHeight - windowOffset);
-
-// gen for movements
-std::uniform_real_distribution<> movementDuration(0.0f, 3.5f);
-std::uniform_int_distribution<> direction(-1, 1);
-
-// define our classes
-class Color {
-    public:
-        float r, g, b;
-
-        Color(float r, float g, float b) : r(r), g(g), b(b) {}
+// pacman's mouth, every shape he can have
+// the mouth is only ever shut or open one of four ways, so all five outlines get made once up front and drawing
+// him just picks one (no trig or mouth tests per frame)
+enum PacManFacing {
+    FACING_RIGHT,
+    FACING_LEFT,
+    FACING_DOWN,
+    FACING_UP,
+    FACING_COUNT
 };
 
-class PacMan {
-    private:
-        float xPos, yPos;
-
-        float radius = 20.0f;
-        float mouthSize = 0.5f;
-        float mouthSpeed = 10.0f;
-        float directionX, directionY = 0.0f;
-
-    public:
-        PacMan(float xPos, float yPos) : xPos(xPos), yPos(yPos) {};
-
-        float getX() {
-            return xPos;
-        }
-
-        float getY() {
-            return yPos;
-        }
-
-        float getRadius() {
-            return radius;
-        }
-
-        void move(float x, float y) {
-            xPos += x;
-            yPos += y;
-
-            // keep track of the direction for the mouth animation
-            directionX = 0.0f;
-            directionY = 0.0f;
-
-            if(x > 0) {
-                directionX = 1.0f;
-            } else if (x < 0) {
-                directionX = -1.0f;
-            } else if (y > 0) {
-                directionY = 1.0f;
-            } else if (y < 0) {
-                directionY = -1.0f;
-            }
-
-            // keep pacman within the window bounds (wrapping around)
-            if(xPos > windowWidth) {
-                xPos = windowOffset;
-            } else if (xPos < windowOffset) {
-                xPos = windowWidth;
+struct PacManShapes {
+    SpriteShape closed;
+    SpriteShape open[FACING_COUNT];
+
+    // his outline at radius 1 around (0, 0), with the mouth cut out facing that way (or no mouth for FACING_COUNT)
+    static SpriteShape outline(int facing) {
+        int segments = 30;
+        std::vector<float> fan = { 0.0f, 0.0f };
+
+        for (int i = 0; i <= segments; i++) {
+            float theta = 2.0f * 3.1415926f * float(i) / float(segments);
+            bool inMouth = false;
+
+            // determine if the current vertex is within the mouth opening
+            if (facing == FACING_RIGHT) {
+                inMouth = theta < mouthSize || theta > (2.0f * 3.14159f - mouthSize);
+            } else if (facing == FACING_LEFT) {
+                inMouth = theta > (3.14159f - mouthSize) && theta < (3.14159f + mouthSize);
+            } else if (facing == FACING_DOWN) {
+                inMouth = theta > (1.5708f - mouthSize) && theta < (1.5708f + mouthSize);
+            } else if (facing == FACING_UP) {
+                inMouth = theta > (4.71239f - mouthSize) && theta < (4.71239f + mouthSize);
             }
 
-            if(yPos > windowHeight) {
-                yPos = windowOffset;
-            } else if (yPos < windowOffset) {
-                yPos = windowHeight;
+            // if we are in the mouth, the vertex goes to the center
+            // this lets the vertexes that were not rendered not draw lines in between themselves
+            if (inMouth) {
+                fan.insert(fan.end(), { 0.0f, 0.0f });
+            } else {
+                fan.insert(fan.end(), { cosf(theta), sinf(theta) });
             }
         }
 
-        void draw(float currentTime) {
-            int segments = 30;
-
-            glBegin(GL_TRIANGLE_FAN);
-            glColor3f(1.0f, 1.0f, 0.0f); // yellow cause pacman yellow
-            glVertex2f(xPos, yPos); 
-
-            for (int i = 0; i <= segments; i++) {
-                float theta = 2.0f * 3.1415926f * float(i) / float(segments);
-                bool inMouth = false;
-
-                // determine if the current vertex is within the mouth opening
-                // only render on specific frames though, to make it look like the mouth is opening and closing
-                if((int)(currentTime * mouthSpeed) % 2 == 0) {
-                    if (directionX > 0) {
-                        if (theta < mouthSize || theta > (2.0f * 3.14159f - mouthSize)) {
-                            inMouth = true;
-                        }
-                    } else if (directionX < 0) {
-                        if (theta > (3.14159f - mouthSize) && theta < (3.14159f + mouthSize)) {
-                            inMouth = true;
-                        }
-                    } else if (directionY > 0) {
-                        if (theta > (1.5708f - mouthSize) && theta < (1.5708f + mouthSize)) {
-                            inMouth = true;
-                        }
-                    } else if (directionY < 0) {
-                        if (theta > (4.71239f - mouthSize) && theta < (4.71239f + mouthSize)) {
-                            inMouth = true;
-                        }
-                    }
-                }
-
-                // if we are in the mouth, we change the position of the vertex
-                // this lets the vertexes that were not rendered not draw lines in between themselves
-                // because opengl weird like that.. idk
-                if (inMouth) {
-                    glVertex2f(xPos, yPos); 
-                } else {
-                    float x = radius * cosf(theta);
-                    float y = radius * sinf(theta);
-                    glVertex2f(xPos + x, yPos + y);
-                }
-            }
+        return SpriteShape::fromFan(fan);
+    }
 
-            glEnd();
+    static PacManShapes build() {
+        PacManShapes shapes;
+        shapes.closed = outline(FACING_COUNT);
+        for (int facing = 0; facing < FACING_COUNT; facing++) {
+            shapes.open[facing] = outline(facing);
         }
+        return shapes;
+    }
 };
 
-class Ghost {
-    private:
-        Color color;
-
-        float xPos, yPos;
-
-        float width = 30.0f; 
-        float radius = width / 2.0f;
-
-        float directionX, directionY = 0.0f;
-        float directionTimer = 0.0f;
-    
-    public:
-        Ghost(Color color, float xPos, float yPos) : color(color), xPos(xPos), yPos(yPos) {};
-
-        float getX() {
-            return xPos;
+// shapes everything gets drawn with, made once
+SpriteShape foodShape = SpriteShape::circle(10);
+SpriteShape ghostShape = SpriteShape::ghost();
+PacManShapes pacmanShapes = PacManShapes::build();
+
+// pacman's state lives in the game (game.h), this just draws him
+void drawPacMan(SpriteBatch& batch, const PacMan& pacman, float alpha, float currentTime) {
+    float directionX = pacman.getDirectionX(), directionY = pacman.getDirectionY();
+    float xPos = blend(pacman.getPreviousX(), pacman.getX(), alpha);
+    float yPos = blend(pacman.getPreviousY(), pacman.getY(), alpha);
+
+    // the mouth is only open on every other step of the animation, to make it look like it's opening and closing
+    // (and there's no mouth before he's moved at all)
+    const SpriteShape* shape = &pacmanShapes.closed;
+    if ((int)(currentTime * mouthSpeed) % 2 == 0) {
+        if (directionX > 0) {
+            shape = &pacmanShapes.open[FACING_RIGHT];
+        } else if (directionX < 0) {
+            shape = &pacmanShapes.open[FACING_LEFT];
+        } else if (directionY > 0) {
+            shape = &pacmanShapes.open[FACING_DOWN];
+        } else if (directionY < 0) {
+            shape = &pacmanShapes.open[FACING_UP];
         }
+    }
 
-        float getY() {
-            return yPos;
-        }
+    batch.add(*shape, xPos, yPos, pacman.getRadius(), 1.0f, 1.0f, 0.0f); // yellow cause pacman yellow
+}
 
-        float getRadius() {
-            return radius;
-        }
+// ghosts and food live in entity stores (see entities.h), these are the systems that draw them
 
-        void draw() {
-            int segments = 10; 
+// every ghost, all the same shape in their own color
+void drawGhosts(SpriteBatch& batch, const EntityStore& ghosts, float alpha) {
+    for (int g = 0; g < ghosts.size(); g++) {
+        float xPos = blend(ghosts.previousX[g], ghosts.x[g], alpha);
+        float yPos = blend(ghosts.previousY[g], ghosts.y[g], alpha);
+        batch.add(ghostShape, xPos, yPos, ghosts.radius[g], ghosts.red[g], ghosts.green[g], ghosts.blue[g]);
+    }
+}
 
-            glBegin(GL_TRIANGLE_FAN);
-            glColor3f(color.r, color.g, color.b);
+void drawFoods(SpriteBatch& batch, const EntityStore& foods, float alpha) {
+    for (int f = 0; f < foods.size(); f++) {
+        float xPos = blend(foods.previousX[f], foods.x[f], alpha);
+        float yPos = blend(foods.previousY[f], foods.y[f], alpha);
+        batch.add(foodShape, xPos, yPos, foods.radius[f], foods.red[f], foods.green[f], foods.blue[f]);
+    }
+}
 
-            glVertex2f(xPos, yPos); 
-            glVertex2f(xPos - radius, yPos + radius); // bottom left
-            glVertex2f(xPos - radius, yPos - radius); // top left
+// check the collision of two circles (used for pacman, food and the ghosts)
+// uses the pythagorean theorem to determine the distance between the centers of the two circles
+// if the distance between the two is less than the sum of the radii, then there is a collision
+// (compared squared, so no sqrt needed)
+bool checkCollision(float x1, float y1, float r1, float x2, float y2, float r2) {
+    float dx = x1 - x2;
+    float dy = y1 - y2;
 
-            // render the top dome of the ghost
-            for (int i = 0; i <= segments; i++) {
-                float theta = 3.14159f + (float(i) / (float)segments) * 3.14159f;
-                float x = radius * cosf(theta);
-                float y = radius * sinf(theta);
-                glVertex2f(xPos + x, (yPos - radius) + y);
-            }
+    return dx * dx + dy * dy < (r1 + r2) * (r1 + r2);
+}
 
-            // render bottom right endpoint of the square
-            glVertex2f(xPos + radius, yPos + radius);
+// --bench-collisions, every agent against every other agent (like the crowd sim does)
+// brute force all pairs against the spatial hash, at a fixed density so the world grows with the agent count
+void benchmarkCollisions() {
+    const float agentRadius = 5.0f;
+    const float areaPerAgent = 40.0f * 40.0f;
+    auto secondsSince = [](std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    };
+
+    std::cout << "Collision benchmark (agent vs agent, radius " << agentRadius << "):" << std::endl;
+
+    for (int count : { 100, 10000, 100000 }) {
+        float side = std::sqrt(count * areaPerAgent);
+        std::default_random_engine random(count);
+        std::uniform_real_distribution<float> position(0.0f, side);
+
+        std::vector<float> xs(count), ys(count), radii(count, agentRadius);
+        for (int i = 0; i < count; i++) {
+            xs[i] = position(random);
+            ys[i] = position(random);
+        }
 
-            int numTriangles = 4; 
-            int totalSteps = numTriangles * 2; 
-            float stepWidth = width / (float)totalSteps;
+        // all pairs at 100k is 5 billion tests, so past a point only the first rows run and the time gets scaled up
+        const double maxBruteTests = 2e8;
+        int bruteRows = 0;
+        double tests = 0.0;
+        while (bruteRows < count && tests < maxBruteTests) {
+            tests += count - bruteRows - 1;
+            bruteRows++;
+        }
+        double allTests = (double)count * (count - 1) / 2.0;
 
-            // render the zig-zag at the bottom
-            for (int i = 1; i <= totalSteps; i++) {
-                float x = (xPos + radius) - (i * stepWidth);
-                float y = (i % 2 != 0) ? (yPos + radius + (width / 5)) : (yPos + radius);
-                glVertex2f(x, y);
+        long brutePairs = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < bruteRows; i++) {
+            for (int j = i + 1; j < count; j++) {
+                if (checkCollision(xs[i], ys[i], radii[i], xs[j], ys[j], radii[j])) brutePairs++;
             }
-
-            // close the loop by ending at the same point we started with
-            glVertex2f(xPos - radius, yPos + radius);
-
-            glEnd();
         }
+        double bruteSeconds = secondsSince(start) * (allTests / tests);
+
+        SpatialHash hash;
+        long hashPairs = 0;
+        start = std::chrono::steady_clock::now();
+        hash.build(0.0f, 0.0f, side, side, SpatialHash::cellSizeFor(agentRadius), count, xs.data(), ys.data(), radii.data());
+        hash.forEachOverlappingPair([&](int, int) { hashPairs++; });
+        double hashSeconds = secondsSince(start);
+
+        std::cout << "  " << count << " agents: brute force " << bruteSeconds * 1000.0 << " ms"
+            << (bruteRows < count ? " (estimated)" : "") << ", spatial hash " << hashSeconds * 1000.0 << " ms, "
+            << hashPairs << " overlapping pairs";
+        if (bruteRows == count && brutePairs != hashPairs) std::cout << " (brute force found " << brutePairs << "!)";
+        std::cout << std::endl;
+    }
+}
 
-        void update(float timeDelta) {
-            directionTimer -= timeDelta;
+// held down WASD keys as GameInput bits
+int readInput(GLFWwindow* window) {
+    int input = 0;
+    if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS) input |= INPUT_UP;
+    if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS) input |= INPUT_DOWN;
+    if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS) input |= INPUT_LEFT;
+    if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS) input |= INPUT_RIGHT;
+    return input;
+}
 
-            // if the timer is up, generate a new random direction and reset the timer
-            if(directionTimer <= 0) {
-                directionX = direction(generator);
-                directionY = direction(generator);
-                directionTimer = movementDuration(generator);
+// main function 
+// --seed <n> picks the starting layout and everything the ghosts and food roll (same seed + same input = same game)
+// --ghosts <n>, --foods <n> and --size <w>x<h> change how many there are and how big the field (and window) is
+// --wandering-ghosts makes the ghosts wander around at random instead of chasing pacman, --tile <n> sets the size
+//   of the tiles they find their way with
+// --maze <file> plays in a maze with walls (see maze.h for the format, maze.txt is one), the window gets sized to
+//   fit it at --tile pixels per tile
+// --bench-collisions times brute force collision checks against the spatial hash and exits
+// --headless <games> plays that many games without a window on every core and reports scores and ticks/s, then exits
+//   (with --threads <n>, --max-ticks <n>, --csv, and --script "D60 WD30 -20" to play a fixed script instead of
+//    random keys, see parseScript)
+// --record <file> saves the game (seed, config and the keys held every tick) when it ends
+// --replay <file> plays a recorded game back exactly and reports frame times, add --no-window to run it as fast
+//   as it goes without a window and time every tick instead
+int main(int argc, char** argv) {
+    uint64_t seed = 0;
+    GameConfig config;
+    bool headless = false;
+    std::string recordPath, replayPath, mazePath;
+    bool replayWindow = true;
+    HeadlessOptions headlessOptions;
+    headlessOptions.threadCount = defaultThreadCount();
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+
+        if (arg == "--bench-collisions") {
+            benchmarkCollisions();
+            return 0;
+        } else if (arg == "--seed" && i + 1 < argc) {
+            const char* text = argv[++i];
+            char* end = nullptr;
+            errno = 0;
+            unsigned long long value = std::strtoull(text, &end, 10);
+            if (end != text && *end == '\0' && text[0] != '-' && errno != ERANGE) {
+                seed = value;
+            } else {
+                std::cout << "--seed wants a whole number 0 or more, ignoring it" << std::endl;
             }
-
-            xPos += directionX * timeDelta * baseMovementSpeed;
-            yPos += directionY * timeDelta * baseMovementSpeed;
-
-            // keep the ghost within the window bounds (wrapping around)
-            if(xPos > windowWidth) {
-                xPos = windowOffset;
-            } else if (xPos < windowOffset) {
-                xPos = windowWidth;
+        } else if (arg == "--ghosts" && i + 1 < argc) {
+            config.numOfMonsters = std::max(0, std::atoi(argv[++i]));
+        } else if (arg == "--foods" && i + 1 < argc) {
+            config.numOfFoodObjects = std::max(0, std::atoi(argv[++i]));
+        } else if (arg == "--size" && i + 1 < argc) {
+            int width = 0, height = 0;
+            if (std::sscanf(argv[++i], "%dx%d", &width, &height) == 2 && width > config.windowOffset * 2 && height > config.windowOffset * 2) {
+                config.windowWidth = width;
+                config.windowHeight = height;
+            } else {
+                std::cout << "--size wants <w>x<h> bigger than " << config.windowOffset * 2 << " each way, ignoring it" << std::endl;
             }
-
-            if(yPos > windowHeight - windowOffset) {
-                yPos = windowOffset;
-            } else if (yPos < windowOffset) {
-                yPos = windowHeight - windowOffset;
+        } else if (arg == "--wandering-ghosts") {
+            config.ghostsChase = false;
+        } else if (arg == "--tile" && i + 1 < argc) {
+            config.tileSize = std::max(4, std::atoi(argv[++i]));
+        } else if (arg == "--maze" && i + 1 < argc) {
+            mazePath = argv[++i];
+        } else if (arg == "--headless" && i + 1 < argc) {
+            headless = true;
+            headlessOptions.games = std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "--threads" && i + 1 < argc) {
+            headlessOptions.threadCount = std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "--max-ticks" && i + 1 < argc) {
+            headlessOptions.maxTicks = std::max(1L, std::atol(argv[++i]));
+        } else if (arg == "--script" && i + 1 < argc) {
+            if (parseScript(argv[++i], headlessOptions.script)) {
+                headlessOptions.controller = CONTROLLER_SCRIPTED;
+            } else {
+                std::cout << "couldn't read the script, using the random controller" << std::endl;
             }
+        } else if (arg == "--csv") {
+            headlessOptions.csv = true;
+        } else if (arg == "--record" && i + 1 < argc) {
+            recordPath = argv[++i];
+        } else if (arg == "--replay" && i + 1 < argc) {
+            replayPath = argv[++i];
+        } else if (arg == "--no-window") {
+            replayWindow = false;
         }
-};
-
-class Food {
-    private:
-        Color color = Color(255, 105, 180);
-
-        float radius = 5.0f;
-        float xPos, yPos;
-
-        float directionX, directionY = 0.0f;
-        float directionTimer = 0.0f;
-
-    public:
-        Food(int xPos, int yPos) : xPos(xPos), yPos(yPos) {};
-
-        float getX() {
-            return xPos;
-        }
-
-        float getY() {
-            return yPos;
-        }
+    }
 
-        float getRadius() {
-            return radius;
+    if (!mazePath.empty()) {
+        if (Maze::loadLayout(mazePath, config.mazeLayout)) {
+            Maze maze = Maze::fromLayout(config.mazeLayout, (float)config.tileSize);
+            config.windowWidth = (int)(maze.columns * maze.tileSize);
+            config.windowHeight = (int)(maze.rows * maze.tileSize);
+        } else {
+            std::cout << "couldn't read the maze " << mazePath << ", playing without one" << std::endl;
         }
+    }
 
-        void draw() {
-            int segments = 10;
-
-            glBegin(GL_TRIANGLE_FAN);
-            glColor3f(color.r, color.g, color.b);
-            glVertex2f(xPos, yPos); 
-
-            for (int i = 0; i <= segments; i++) {
-                float theta = 2.0f * 3.1415926f * float(i) / float(segments);
-
-                float x = radius * cosf(theta);
-                float y = radius * sinf(theta);
-
-                glVertex2f(xPos + x, yPos + y);
-            }
-
-            glEnd();
+    // a replay brings its own seed and config
+    Recording recording;
+    bool replaying = !replayPath.empty();
+    if (replaying) {
+        if (!recording.load(replayPath)) {
+            std::cout << "couldn't read the recording " << replayPath << std::endl;
+            return 1;
         }
+        seed = recording.seed;
+        config = recording.config;
 
-        // same func as ghost
-        // food moves slower though
-        void update(float timeDelta) {
-            directionTimer -= timeDelta;
-
-            // if the timer is up, generate a new random direction and reset the timer
-            if(directionTimer <= 0) {
-                directionX = direction(generator);
-                directionY = direction(generator);
-                directionTimer = movementDuration(generator);
-            }
-
-            xPos += directionX * timeDelta * (float)(baseMovementSpeed / 3);
-            yPos += directionY * timeDelta * (float)(baseMovementSpeed / 3);
-
-            // keep the food within the window bounds (wrapping around)
-            if(xPos > windowWidth ) {
-                xPos = windowOffset;
-            } else if (xPos < 0) {
-                xPos = windowWidth;
-            }
-
-            if(yPos > windowHeight) {
-                yPos = windowOffset;
-            } else if (yPos < 0) {
-                yPos = windowHeight;
-            }
+        if (!replayWindow) {
+            replayHeadless(recording);
+            return 0;
         }
-};
-
-std::vector<Ghost> generateGhosts() {
-    std::vector<Ghost> ghosts = {};
-
-    for (int i = 0; i < numOfMonsters; i++) {
-        ghosts.push_back(Ghost(Color(colorDistributor(generator), colorDistributor(generator), colorDistributor(generator)), widthDistribution(generator), heightDistribution(generator)));
+    } else {
+        recording.seed = seed;
+        recording.config = config;
     }
 
-    return ghosts;
-};
-
-std::vector<Food> generateFoods() {
-    std::vector<Food> foods = {};
-
-    for (int i = 0; i < numOfFoodObjects; i++) {
-        foods.push_back(Food(widthDistribution(generator), heightDistribution(generator)));
+    if (headless) {
+        headlessOptions.seed = seed;
+        headlessOptions.config = config;
+        runHeadless(headlessOptions);
+        return 0;
     }
 
-    return foods;
-};
+    Game game(seed, config);
 
-// check the collision of two circles (used for pacman, food and the ghosts)
-// uses the pythagorean theorem to determine the distance between the centers of the two circles
-// if the distance between the two is less than the sum of the radii, then there is a collision
-bool checkCollision(float x1, float y1, float r1, float x2, float y2, float r2) {
-    float dx = x1 - x2;
-    float dy = y1 - y2;
-    float distance = sqrt(dx * dx + dy * dy);
-
-    return distance < (r1 + r2);
-}
-
-PacMan pacman(widthDistribution(generator), heightDistribution(generator));
-
-std::vector<Ghost> ghosts = generateGhosts();
-std::vector<Food> foods = generateFoods();
-
-// main function 
-int main() {
     if (!glfwInit()) return -1;
 
-    GLFWwindow* window = glfwCreateWindow(windowWidth, windowHeight, "Project2", NULL, NULL);
+    GLFWwindow* window = glfwCreateWindow(config.windowWidth, config.windowHeight, "Project2", NULL, NULL);
     if (!window) {
         glfwTerminate();
         return -1;
     }
 
     double lastTime = glfwGetTime();
-    int pacmanMovementSpeed = baseMovementSpeed * 1.25;
+    double accumulator = 0.0;
+    SpriteBatch batch;
+    MazeMesh mazeMesh;
+    mazeMesh.build(game.maze);
+    std::vector<double> frameTimes; // milliseconds, for the replay report
 
     glfwMakeContextCurrent(window);
     while (!glfwWindowShouldClose(window)) {
         double currentTime = glfwGetTime();
-        float deltaTime = (float)(currentTime - lastTime);
-        
-        glClear(GL_COLOR_BUFFER_BIT);
-        
-        glViewport(0, 0, windowWidth, windowHeight);
-        glMatrixMode(GL_MODELVIEW);
-        glLoadIdentity();
-        glOrtho(0, windowWidth, windowHeight, 0, -1, 1);
-
-        // listen for WASD input to move pacman
-        if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS) {
-            pacman.move(0, -pacmanMovementSpeed * deltaTime);
-        }
-        if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS) {
-            pacman.move(0, pacmanMovementSpeed * deltaTime);
-        }
-        if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS) {
-            pacman.move(-pacmanMovementSpeed * deltaTime, 0);
-        }
-        if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS) {
-            pacman.move(pacmanMovementSpeed * deltaTime, 0);
-        }
+        if (game.ticks > 0) frameTimes.push_back((currentTime - lastTime) * 1000.0);
+        accumulator += std::min(currentTime - lastTime, maxFrameTime);
+        lastTime = currentTime;
 
-        // check for collisions between pacman and the food
-        for (auto it = foods.begin(); it != foods.end();) {
-            if (checkCollision(pacman.getX(), pacman.getY(), pacman.getRadius(), it->getX(), it->getY(), it->getRadius())) {
-                it = foods.erase(it);
-                score += 10;
-            } else {
-                ++it;
+        // run the game in fixed ticks for however much time passed, the keys held this frame count for all of them
+        // (a replay takes each tick's keys from the recording instead)
+        int input = readInput(window);
+        bool replayOver = replaying && game.ticks >= (long)recording.inputs.size();
+        while (accumulator >= tickDelta && game.state == GAME_PLAYING && !replayOver) {
+            if (replaying) {
+                input = recording.inputs[game.ticks];
+            } else if (!recordPath.empty()) {
+                recording.inputs.push_back((uint8_t)input);
             }
-        }
-
-        // check for collisions between pacman and the ghosts
-        // isn't perfect since the ghosts are not perfect circles, but who cares
-        // if we collide with a ghost, we end the game by setting the window to close
-        // i'm way too lazy to implement something cool here, sorry TAs!
-        for (auto& ghost : ghosts) {
-            if (checkCollision(pacman.getX(), pacman.getY(), pacman.getRadius(), ghost.getX(), ghost.getY(), 15.0f)) {
-                std::cout << "Game Over!" << std::endl;
-                std::cout << "Score: " << score << std::endl;
 
-                glfwWaitEventsTimeout(6.0); // wait a little before closing the window so the player can see the collision
-                glfwSetWindowShouldClose(window, true);
-            }
+            game.tick(input);
+            accumulator -= tickDelta;
+            replayOver = replaying && game.ticks >= (long)recording.inputs.size();
         }
 
-        // check to see if any food is left, if not we win and end the game
-        if(foods.size() == 0) {
-            std::cout << "You Win!" << std::endl;
-            std::cout << "Score: " << score << std::endl;
+        // how far we are into the next tick, everything gets drawn that far between its last two positions
+        float alpha = (game.state == GAME_PLAYING) ? (float)(accumulator / tickDelta) : 1.0f;
 
-            glfwWaitEventsTimeout(6.0); // wait a little before closing so they can savor the win
-            glfwSetWindowShouldClose(window, true);
-        }
+        glClear(GL_COLOR_BUFFER_BIT);
+        
+        glViewport(0, 0, config.windowWidth, config.windowHeight);
+        glMatrixMode(GL_MODELVIEW);
+        glLoadIdentity();
+        glOrtho(0, config.windowWidth, config.windowHeight, 0, -1, 1);
+
+        // the walls go down first, they're already sitting in their buffer
+        mazeMesh.draw();
 
         // render the food, pacman and the ghosts
         // in a specific order to make sure food is behind pacman, and pacman is behind the ghosts
         // idk I watch a video on pacman and that's how it looked like so we ball
-        for (auto& food : foods) {
-            food.draw();
-            food.update(deltaTime);
-        }
-
-        pacman.draw(currentTime);
-        
-        for (auto& ghost : ghosts) {
-            ghost.draw();
-            ghost.update(deltaTime);
-        }
+        // all of it goes into one batch and out in a single draw call
+        batch.begin();
+        drawFoods(batch, game.foods, alpha);
+        drawPacMan(batch, game.pacman, alpha, currentTime);
+        drawGhosts(batch, game.ghosts, alpha);
+        batch.end();
 
         glfwSwapBuffers(window);
         glfwPollEvents();
 
-        lastTime = currentTime;
+        // if we collided with a ghost, or there's no food left, we end the game by setting the window to close
+        // i'm way too lazy to implement something cool here, sorry TAs!
+        if (game.state != GAME_PLAYING || replayOver) {
+            std::cout << (game.state == GAME_WON ? "You Win!" : game.state == GAME_LOST ? "Game Over!" : "Replay Over!") << std::endl;
+            std::cout << "Score: " << game.score << std::endl;
+            std::cout << "(" << batch.drawCallsPerFrame() + (mazeMesh.triangleCount() > 0 ? 1 : 0) << " draw calls per frame)" << std::endl;
+            printFlowFieldTime(game.flowField.rebuilds(), game.flowField.secondsRebuilding());
+
+            // wait a little before closing the window so the player can see how it ended (not for replays, they're benchmarks)
+            if (!replaying) glfwWaitEventsTimeout(6.0);
+            glfwSetWindowShouldClose(window, true);
+        }
+    }
+
+    if (replaying) {
+        printReplayResult(recording, game);
+        printTimings("frame times", frameTimes, "ms");
+    } else if (!recordPath.empty()) {
+        // also when the window got closed partway through, the replay just stops where this did
+        recording.finish(game);
+        if (recording.save(recordPath)) {
+            std::cout << "Recorded " << recording.inputs.size() << " ticks to " << recordPath << std::endl;
+        } else {
+            std::cout << "couldn't write the recording to " << recordPath << std::endl;
+        }
     }
 
     glfwTerminate();
     return 0;
-};
\ No newline at end of file
+};
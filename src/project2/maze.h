@@ -0,0 +1,157 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+
+// the field cut into square tiles, each one either open or a wall
+// positions map to tiles with a divide, so "what tile is this in" and "is that a wall" are both O(1).
+// anything outside the grid counts as a wall for finding a way around, but not for collisions (so things can
+// still leave the grid through an open edge and wrap around)
+//
+// a maze file is plain text, one line per row of tiles: # is a wall, anything else is open
+// short lines are open past their end
+
+class Maze {
+    public:
+        int columns = 0, rows = 0;
+        float tileSize = 32.0f;
+        std::vector<uint8_t> walls; // [row * columns + column], 1 for a wall
+        int wallCount = 0;
+
+        // no walls at all, just enough tiles to cover width x height
+        static Maze open(float width, float height, float tileSize) {
+            Maze maze;
+            maze.tileSize = tileSize;
+            maze.columns = std::max(1, (int)std::ceil(width / tileSize));
+            maze.rows = std::max(1, (int)std::ceil(height / tileSize));
+            maze.walls.assign((size_t)maze.columns * maze.rows, 0);
+            return maze;
+        }
+
+        // from the rows of a maze file
+        static Maze fromLayout(const std::vector<std::string>& layout, float tileSize) {
+            Maze maze;
+            maze.tileSize = tileSize;
+            maze.rows = std::max(1, (int)layout.size());
+            maze.columns = 1;
+            for (const std::string& line : layout) maze.columns = std::max(maze.columns, (int)line.size());
+
+            maze.walls.assign((size_t)maze.columns * maze.rows, 0);
+            for (int row = 0; row < (int)layout.size(); row++) {
+                for (int column = 0; column < (int)layout[row].size(); column++) {
+                    if (layout[row][column] != '#') continue;
+                    maze.walls[(size_t)row * maze.columns + column] = 1;
+                    maze.wallCount++;
+                }
+            }
+            return maze;
+        }
+
+        // reads a maze file's rows into layout, false if it can't be read or has no rows
+        static bool loadLayout(const std::string& path, std::vector<std::string>& layout) {
+            std::ifstream file(path);
+            if (!file) return false;
+
+            layout.clear();
+            std::string line;
+            while (std::getline(file, line)) {
+                if (!line.empty() && line.back() == '\r') line.pop_back();
+                layout.push_back(line);
+            }
+            while (!layout.empty() && layout.back().empty()) layout.pop_back();
+            return !layout.empty();
+        }
+
+        int cellCount() const {
+            return columns * rows;
+        }
+
+        bool inside(int column, int row) const {
+            return column >= 0 && column < columns && row >= 0 && row < rows;
+        }
+
+        bool isWall(int column, int row) const {
+            return !inside(column, row) || walls[(size_t)row * columns + column];
+        }
+
+        // tile under a position, clamped onto the grid
+        int column(float x) const {
+            return std::min(std::max((int)std::floor(x / tileSize), 0), columns - 1);
+        }
+
+        int row(float y) const {
+            return std::min(std::max((int)std::floor(y / tileSize), 0), rows - 1);
+        }
+
+        // whether a circle there would overlap a wall (only tiles on the grid count)
+        bool blocked(float x, float y, float radius) const {
+            bool hit = false;
+            forEachWallNear(x, y, radius, [&](float left, float top, float right, float bottom) {
+                float closestX = std::min(std::max(x, left), right), closestY = std::min(std::max(y, top), bottom);
+                float dx = x - closestX, dy = y - closestY;
+                if (dx * dx + dy * dy < radius * radius) hit = true;
+            });
+            return hit;
+        }
+
+        // pushes a circle out of any walls it's overlapping, true if it had to
+        // only looks at the tiles the circle covers, so that's at most 3 x 3 of them for anything up to a tile
+        // across, however big the maze is
+        bool resolveCircle(float& x, float& y, float radius) const {
+            bool moved = false;
+            forEachWallNear(x, y, radius, [&](float left, float top, float right, float bottom) {
+                float closestX = std::min(std::max(x, left), right), closestY = std::min(std::max(y, top), bottom);
+                float dx = x - closestX, dy = y - closestY;
+                float distanceSquared = dx * dx + dy * dy;
+                if (distanceSquared >= radius * radius) return;
+
+                if (distanceSquared > 0.0f) {
+                    // out along the line from the closest point of the wall
+                    float distance = std::sqrt(distanceSquared);
+                    x += dx / distance * (radius - distance);
+                    y += dy / distance * (radius - distance);
+                } else {
+                    // center is inside the wall, out through whichever side is closest
+                    float pushLeft = x - left + radius, pushRight = right - x + radius;
+                    float pushUp = y - top + radius, pushDown = bottom - y + radius;
+                    float shortest = std::min({ pushLeft, pushRight, pushUp, pushDown });
+                    if (shortest == pushLeft) x -= pushLeft;
+                    else if (shortest == pushRight) x += pushRight;
+                    else if (shortest == pushUp) y -= pushUp;
+                    else y += pushDown;
+                }
+                moved = true;
+            });
+            return moved;
+        }
+
+        // visit(left, top, right, bottom) for every wall tile on the grid that a circle could touch
+        template <typename Visit>
+        void forEachWallNear(float x, float y, float radius, const Visit& visit) const {
+            if (wallCount == 0) return;
+
+            int column0 = std::max((int)std::floor((x - radius) / tileSize), 0);
+            int column1 = std::min((int)std::floor((x + radius) / tileSize), columns - 1);
+            int row0 = std::max((int)std::floor((y - radius) / tileSize), 0);
+            int row1 = std::min((int)std::floor((y + radius) / tileSize), rows - 1);
+
+            for (int row = row0; row <= row1; row++) {
+                for (int column = column0; column <= column1; column++) {
+                    if (!walls[(size_t)row * columns + column]) continue;
+                    visit(column * tileSize, row * tileSize, (column + 1) * tileSize, (row + 1) * tileSize);
+                }
+            }
+        }
+
+        float centerX(int column) const {
+            return (column + 0.5f) * tileSize;
+        }
+
+        float centerY(int row) const {
+            return (row + 0.5f) * tileSize;
+        }
+};
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <GLFW/glfw3.h>
+
+#include <vector>
+#include <cstddef>
+
+#include "maze.h"
+#include "sprite_batch.h"
+#include "gl_buffers.h"
+
+// the maze's walls as one static vertex buffer
+// the walls never move, so they get turned into triangles once (each unbroken run of wall tiles along a row
+// is a single quad) and uploaded once, after that drawing them is one glDrawArrays on a buffer that's already
+// on the gpu. without vertex buffers it falls back to drawing the same vertices from our own memory
+
+class MazeMesh {
+    private:
+        std::vector<SpriteVertex> vertices;
+        GLuint buffer = 0;
+        bool uploaded = false;
+
+    public:
+        float red = 0.1f, green = 0.2f, blue = 0.8f; // classic pacman blue
+
+        void build(const Maze& maze) {
+            vertices.clear();
+            uploaded = false;
+
+            for (int row = 0; row < maze.rows; row++) {
+                for (int column = 0; column < maze.columns;) {
+                    if (!maze.isWall(column, row)) {
+                        column++;
+                        continue;
+                    }
+
+                    int end = column;
+                    while (end < maze.columns && maze.isWall(end, row)) end++;
+
+                    float left = column * maze.tileSize, right = end * maze.tileSize;
+                    float top = row * maze.tileSize, bottom = (row + 1) * maze.tileSize;
+                    vertices.push_back({ left, top, red, green, blue });
+                    vertices.push_back({ right, top, red, green, blue });
+                    vertices.push_back({ right, bottom, red, green, blue });
+                    vertices.push_back({ left, top, red, green, blue });
+                    vertices.push_back({ right, bottom, red, green, blue });
+                    vertices.push_back({ left, bottom, red, green, blue });
+
+                    column = end;
+                }
+            }
+        }
+
+        int triangleCount() const {
+            return (int)vertices.size() / 3;
+        }
+
+        void draw() {
+            if (vertices.empty()) return;
+
+            const GLBufferFunctions& gl = glBufferFunctions();
+            if (!uploaded && gl.available()) {
+                if (!buffer) gl.genBuffers(1, &buffer);
+                gl.bindBuffer(GL_ARRAY_BUFFER, buffer);
+                gl.bufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(SpriteVertex), vertices.data(), GL_STATIC_DRAW);
+                gl.bindBuffer(GL_ARRAY_BUFFER, 0);
+                uploaded = true;
+            }
+
+            // with the buffer bound the pointers are offsets into it, otherwise they point at our array
+            const char* base = uploaded ? nullptr : (const char*)vertices.data();
+
+            glEnableClientState(GL_VERTEX_ARRAY);
+            glEnableClientState(GL_COLOR_ARRAY);
+            if (uploaded) gl.bindBuffer(GL_ARRAY_BUFFER, buffer);
+            glVertexPointer(2, GL_FLOAT, sizeof(SpriteVertex), base + offsetof(SpriteVertex, x));
+            glColorPointer(3, GL_FLOAT, sizeof(SpriteVertex), base + offsetof(SpriteVertex, r));
+
+            glDrawArrays(GL_TRIANGLES, 0, (GLsizei)vertices.size());
+
+            if (uploaded) gl.bindBuffer(GL_ARRAY_BUFFER, 0);
+            glDisableClientState(GL_COLOR_ARRAY);
+            glDisableClientState(GL_VERTEX_ARRAY);
+        }
+};
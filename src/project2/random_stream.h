@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+
+// small deterministic random number stream (splitmix64)
+// every entity gets its own one, seeded from the game seed and the entity's id, so what one ghost rolls never
+// depends on how many numbers anything else pulled before it (or in what order things got updated).
+// the distributions are done by hand instead of with <random> since those aren't guaranteed to give the same
+// numbers on every standard library, and a seed has to replay the same everywhere
+
+class RandomStream {
+    private:
+        uint64_t state = 0;
+
+        // splitmix64's output scramble on its own
+        static uint64_t mix(uint64_t z) {
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+            return z ^ (z >> 31);
+        }
+
+    public:
+        RandomStream() = default;
+
+        // the stream id gets hashed into the starting state instead of added to it: the state only ever steps by
+        // a fixed amount, so streams that started a multiple of that apart would just be the same numbers shifted
+        explicit RandomStream(uint64_t seed, uint64_t stream = 0) {
+            state = mix(seed ^ mix(stream + 1));
+        }
+
+        uint64_t next() {
+            return mix(state += 0x9E3779B97F4A7C15ull);
+        }
+
+        // [low, high)
+        float uniform(float low, float high) {
+            return low + (high - low) * (float)(next() >> 40) * (1.0f / 16777216.0f);
+        }
+
+        // [low, high], both ends included like std::uniform_int_distribution
+        int range(int low, int high) {
+            uint64_t count = (uint64_t)(high - low) + 1;
+            return low + (int)(((next() >> 32) * count) >> 32);
+        }
+};
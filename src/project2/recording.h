@@ -0,0 +1,248 @@
+#pragma once
+
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <iostream>
+#include <algorithm>
+
+#include "game.h"
+
+// recorded games, for playing a session back exactly (and timing it)
+// a game only depends on its seed, its config and the input every tick (see game.h), so that's all that gets
+// kept. the inputs are run length encoded since keys are held for many ticks at a time, a few minutes of play
+// is usually well under a kilobyte
+//
+// file layout (native byte order):
+//   RecordingFileHeader
+//   mazeRows lines of mazeColumns characters, the maze layout padded out with '.' (nothing for no maze)
+//   runs times: 1 byte of GameInput bits, then how many ticks it was held as a base 128 varint
+//
+// the header also has how the game ended and a checksum of the final state, so a replay can tell if it
+// really came out the same
+
+const char recordingFileMagic[4] = { 'P', '2', 'R', 'C' };
+const uint32_t recordingFileVersion = 4;
+
+enum RecordingFileFlags {
+    RECORDING_GHOSTS_CHASE = 1
+};
+
+struct RecordingFileHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t seed;
+    int32_t windowWidth, windowHeight, windowOffset;
+    int32_t numOfFoodObjects, numOfMonsters, baseMovementSpeed;
+    uint32_t tickRate;
+    uint32_t ticks;
+    uint32_t runs;
+    uint32_t finalState;
+    int32_t finalScore;
+    int32_t tileSize;
+    uint32_t flags;
+    uint32_t mazeColumns, mazeRows;
+    uint64_t finalChecksum;
+};
+
+class Recording {
+    public:
+        uint64_t seed = 0;
+        GameConfig config;
+        std::vector<uint8_t> inputs; // one per tick
+
+        GameState finalState = GAME_PLAYING;
+        int finalScore = 0;
+        uint64_t finalChecksum = 0;
+
+        // remembers how the game ended up, call it when it's over (or when recording stops)
+        void finish(const Game& game) {
+            finalState = game.state;
+            finalScore = game.score;
+            finalChecksum = game.checksum();
+        }
+
+        bool save(const std::string& path) const {
+            size_t mazeColumns = 0;
+            for (const std::string& line : config.mazeLayout) mazeColumns = std::max(mazeColumns, line.size());
+
+            std::string maze;
+            for (const std::string& line : config.mazeLayout) {
+                maze += line;
+                maze.append(mazeColumns - line.size(), '.');
+            }
+
+            std::vector<uint8_t> runs;
+            uint32_t runCount = 0;
+            for (size_t i = 0; i < inputs.size();) {
+                size_t end = i;
+                while (end < inputs.size() && inputs[end] == inputs[i]) end++;
+
+                runs.push_back(inputs[i]);
+                for (uint64_t length = end - i; ; length >>= 7) {
+                    runs.push_back((uint8_t)((length & 0x7F) | (length >= 0x80 ? 0x80 : 0)));
+                    if (length < 0x80) break;
+                }
+                runCount++;
+                i = end;
+            }
+
+            RecordingFileHeader header;
+            std::memset(&header, 0, sizeof(header));
+            std::memcpy(header.magic, recordingFileMagic, sizeof(header.magic));
+            header.version = recordingFileVersion;
+            header.seed = seed;
+            header.windowWidth = config.windowWidth;
+            header.windowHeight = config.windowHeight;
+            header.windowOffset = config.windowOffset;
+            header.numOfFoodObjects = config.numOfFoodObjects;
+            header.numOfMonsters = config.numOfMonsters;
+            header.baseMovementSpeed = config.baseMovementSpeed;
+            header.tileSize = config.tileSize;
+            header.flags = config.ghostsChase ? RECORDING_GHOSTS_CHASE : 0;
+            header.mazeColumns = (uint32_t)mazeColumns;
+            header.mazeRows = (uint32_t)config.mazeLayout.size();
+            header.tickRate = tickRate;
+            header.ticks = (uint32_t)inputs.size();
+            header.runs = runCount;
+            header.finalState = finalState;
+            header.finalScore = finalScore;
+            header.finalChecksum = finalChecksum;
+
+            FILE* file = std::fopen(path.c_str(), "wb");
+            if (!file) return false;
+
+            bool ok = std::fwrite(&header, sizeof(header), 1, file) == 1;
+            if (ok && !maze.empty()) ok = std::fwrite(maze.data(), 1, maze.size(), file) == maze.size();
+            if (ok && !runs.empty()) ok = std::fwrite(runs.data(), 1, runs.size(), file) == runs.size();
+            return (std::fclose(file) == 0) && ok;
+        }
+
+        // false if the file is missing, from another version or cut short
+        bool load(const std::string& path) {
+            FILE* file = std::fopen(path.c_str(), "rb");
+            if (!file) return false;
+
+            RecordingFileHeader header;
+            bool ok = std::fread(&header, sizeof(header), 1, file) == 1
+                && std::memcmp(header.magic, recordingFileMagic, sizeof(header.magic)) == 0
+                && header.version == recordingFileVersion
+                && header.tickRate == (uint32_t)tickRate;
+
+            // everything after the header, so sizes from the header can be checked before anything gets allocated
+            long remaining = 0;
+            if (ok) {
+                long start = std::ftell(file);
+                std::fseek(file, 0, SEEK_END);
+                remaining = std::ftell(file) - start;
+                std::fseek(file, start, SEEK_SET);
+                ok = start >= 0 && remaining >= 0;
+            }
+
+            std::string maze;
+            if (ok) {
+                uint64_t mazeSize = (uint64_t)header.mazeColumns * header.mazeRows;
+                ok = mazeSize <= (uint64_t)remaining;
+                if (ok) {
+                    maze.resize((size_t)mazeSize);
+                    ok = maze.empty() || std::fread(&maze[0], 1, maze.size(), file) == maze.size();
+                    remaining -= (long)mazeSize;
+                }
+            }
+
+            std::vector<uint8_t> runs;
+            if (ok) {
+                runs.resize((size_t)remaining);
+                ok = runs.empty() || std::fread(runs.data(), 1, runs.size(), file) == runs.size();
+            }
+            std::fclose(file);
+            if (!ok) return false;
+
+            inputs.clear();
+            inputs.reserve(header.ticks);
+            size_t at = 0;
+            for (uint32_t run = 0; run < header.runs; run++) {
+                if (at >= runs.size()) return false;
+                uint8_t input = runs[at++];
+
+                uint64_t length = 0;
+                for (int shift = 0; ; shift += 7) {
+                    if (at >= runs.size() || shift > 63) return false;
+                    uint8_t byte = runs[at++];
+                    length |= (uint64_t)(byte & 0x7F) << shift;
+                    if (!(byte & 0x80)) break;
+                }
+                if (inputs.size() + length > header.ticks) return false;
+                inputs.insert(inputs.end(), (size_t)length, input);
+            }
+            if (inputs.size() != header.ticks) return false;
+
+            seed = header.seed;
+            config.windowWidth = header.windowWidth;
+            config.windowHeight = header.windowHeight;
+            config.windowOffset = header.windowOffset;
+            config.numOfFoodObjects = header.numOfFoodObjects;
+            config.numOfMonsters = header.numOfMonsters;
+            config.baseMovementSpeed = header.baseMovementSpeed;
+            config.tileSize = header.tileSize;
+            config.ghostsChase = (header.flags & RECORDING_GHOSTS_CHASE) != 0;
+            config.mazeLayout.clear();
+            for (uint32_t row = 0; row < header.mazeRows; row++) {
+                config.mazeLayout.push_back(maze.substr((size_t)row * header.mazeColumns, header.mazeColumns));
+            }
+            finalState = (GameState)header.finalState;
+            finalScore = header.finalScore;
+            finalChecksum = header.finalChecksum;
+            return true;
+        }
+};
+
+// mean, median, 95th / 99th percentile and worst of a bunch of timings
+inline void printTimings(const std::string& label, std::vector<double> samples, const std::string& unit) {
+    if (samples.empty()) return;
+
+    std::sort(samples.begin(), samples.end());
+    double sum = 0.0;
+    for (double sample : samples) sum += sample;
+    auto percentile = [&](double p) {
+        return samples[std::min(samples.size() - 1, (size_t)(p * (samples.size() - 1) + 0.5))];
+    };
+
+    std::cout << "  " << label << " (" << samples.size() << "): mean " << sum / samples.size() << " " << unit
+        << ", median " << percentile(0.5) << ", 95% " << percentile(0.95) << ", 99% " << percentile(0.99)
+        << ", worst " << samples.back() << " " << unit << std::endl;
+}
+
+// whether a replayed game ended exactly like the recording says it did
+inline bool replayMatches(const Recording& recording, const Game& game) {
+    return game.state == recording.finalState && game.score == recording.finalScore && game.checksum() == recording.finalChecksum;
+}
+
+inline void printReplayResult(const Recording& recording, const Game& game) {
+    std::cout << "Replayed " << game.ticks << " of " << recording.inputs.size() << " ticks, score " << game.score
+        << (replayMatches(recording, game) ? ", same as the recording" : ", DIFFERENT from the recording (score " + std::to_string(recording.finalScore) + ")")
+        << std::endl;
+}
+
+// plays a recording back as fast as it goes, no window, and times every tick
+inline void replayHeadless(const Recording& recording) {
+    Game game(recording.seed, recording.config);
+    std::vector<double> tickTimes;
+    tickTimes.reserve(recording.inputs.size());
+
+    auto start = std::chrono::steady_clock::now();
+    for (uint8_t input : recording.inputs) {
+        auto tickStart = std::chrono::steady_clock::now();
+        game.tick(input);
+        tickTimes.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - tickStart).count());
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    printReplayResult(recording, game);
+    printTimings("tick times", tickTimes, "us");
+    std::cout << "  " << game.ticks / seconds << " ticks/s" << std::endl;
+    printFlowFieldTime(game.flowField.rebuilds(), game.flowField.secondsRebuilding());
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+// uniform grid for circle overlap queries
+// instead of testing pacman (or every agent) against everything, the entities get sorted into square cells once
+// per tick and a query only looks at the cells its circle can reach. rebuilt from scratch every tick with a
+// counting sort, so it's two passes over the entities and nothing gets allocated once the buffers have grown
+//
+// anything outside the bounds lands in the nearest edge cell, queries get clamped the same way, so it's still
+// correct (just slower) for things that wander off the grid
+
+class SpatialHash {
+    private:
+        float minX = 0.0f, minY = 0.0f;
+        float cellSize = 1.0f;
+        int columns = 1, rows = 1;
+        float maxRadius = 0.0f;
+
+        std::vector<int> cellStart; // entries of cell c are [cellStart[c], cellStart[c + 1])
+        std::vector<int> ids;       // sorted by cell, with their circles next to them so queries stay in one place
+        std::vector<float> xs, ys, radii;
+        std::vector<int> cellOf, cursor; // scratch for the sort
+
+        int column(float x) const {
+            return std::min(std::max((int)std::floor((x - minX) / cellSize), 0), columns - 1);
+        }
+
+        int row(float y) const {
+            return std::min(std::max((int)std::floor((y - minY) / cellSize), 0), rows - 1);
+        }
+
+        template <typename Visit>
+        void testPair(int slot, int other, const Visit& visit) const {
+            float dx = xs[slot] - xs[other], dy = ys[slot] - ys[other], reach = radii[slot] + radii[other];
+            if (dx * dx + dy * dy < reach * reach) visit(ids[slot], ids[other]);
+        }
+
+    public:
+        // size is a good default cell size for entities up to that radius (2x, so most queries touch 2 x 2 cells)
+        static float cellSizeFor(float largestRadius) {
+            return std::max(1.0f, largestRadius * 2.0f);
+        }
+
+        // sorts count circles into cells of size cell over [left, right] x [top, bottom]
+        void build(float left, float top, float right, float bottom, float cell, int count, const float* x, const float* y, const float* r) {
+            minX = left;
+            minY = top;
+            cellSize = cell;
+            columns = std::max(1, (int)std::ceil((right - left) / cell));
+            rows = std::max(1, (int)std::ceil((bottom - top) / cell));
+
+            cellStart.assign((size_t)columns * rows + 1, 0);
+            cellOf.resize(count);
+            maxRadius = 0.0f;
+            for (int i = 0; i < count; i++) {
+                cellOf[i] = row(y[i]) * columns + column(x[i]);
+                cellStart[cellOf[i] + 1]++;
+                maxRadius = std::max(maxRadius, r[i]);
+            }
+            for (size_t c = 1; c < cellStart.size(); c++) {
+                cellStart[c] += cellStart[c - 1];
+            }
+
+            ids.resize(count);
+            xs.resize(count);
+            ys.resize(count);
+            radii.resize(count);
+            cursor.assign(cellStart.begin(), cellStart.end() - 1);
+            for (int i = 0; i < count; i++) {
+                int slot = cursor[cellOf[i]]++;
+                ids[slot] = i;
+                xs[slot] = x[i];
+                ys[slot] = y[i];
+                radii[slot] = r[i];
+            }
+        }
+
+        // visit(id) for every circle overlapping (x, y, radius), same test as checkCollision (distance < r1 + r2)
+        template <typename Visit>
+        void query(float x, float y, float radius, const Visit& visit) const {
+            float reach = radius + maxRadius;
+            int column0 = column(x - reach), column1 = column(x + reach);
+            int row0 = row(y - reach), row1 = row(y + reach);
+
+            for (int cellRow = row0; cellRow <= row1; cellRow++) {
+                for (int cellColumn = column0; cellColumn <= column1; cellColumn++) {
+                    int cell = cellRow * columns + cellColumn;
+                    for (int slot = cellStart[cell]; slot < cellStart[cell + 1]; slot++) {
+                        float dx = xs[slot] - x, dy = ys[slot] - y, reachBoth = radii[slot] + radius;
+                        if (dx * dx + dy * dy < reachBoth * reachBoth) visit(ids[slot]);
+                    }
+                }
+            }
+        }
+
+        // visit(a, b) once for every overlapping pair of the circles the grid was built with
+        // only looks at the cell itself and the half of its neighbors that come after it, so no pair shows up twice
+        template <typename Visit>
+        void forEachOverlappingPair(const Visit& visit) const {
+            // pairs can reach further than one cell when the biggest circle is bigger than half a cell
+            int span = std::max(1, (int)std::ceil(maxRadius * 2.0f / cellSize));
+
+            for (int cellRow = 0; cellRow < rows; cellRow++) {
+                for (int cellColumn = 0; cellColumn < columns; cellColumn++) {
+                    int cell = cellRow * columns + cellColumn;
+
+                    for (int slot = cellStart[cell]; slot < cellStart[cell + 1]; slot++) {
+                        // the rest of this cell
+                        for (int other = slot + 1; other < cellStart[cell + 1]; other++) {
+                            testPair(slot, other, visit);
+                        }
+
+                        // neighbors later in row order: the rest of this row, then full rows below
+                        for (int neighborRow = cellRow; neighborRow <= std::min(cellRow + span, rows - 1); neighborRow++) {
+                            int firstColumn = (neighborRow == cellRow) ? cellColumn + 1 : std::max(cellColumn - span, 0);
+                            for (int neighborColumn = firstColumn; neighborColumn <= std::min(cellColumn + span, columns - 1); neighborColumn++) {
+                                int neighbor = neighborRow * columns + neighborColumn;
+                                for (int other = cellStart[neighbor]; other < cellStart[neighbor + 1]; other++) {
+                                    testPair(slot, other, visit);
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+        }
+};
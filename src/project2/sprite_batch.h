@@ -0,0 +1,133 @@
+#pragma once
+
+#include <GLFW/glfw3.h>
+
+#include <vector>
+#include <cmath>
+
+// everything on screen in one draw call
+// shapes are made once as plain triangles around (0, 0) at size 1 (a SpriteShape), and every frame each
+// entity just gets its shape's triangles scaled, moved and colored into one big vertex array. flush hands that
+// whole array to opengl with a single glDrawArrays, so the number of draw calls doesn't grow with the number
+// of things on screen. triangles go in the order they were added, so things added later still draw on top
+
+struct SpriteVertex {
+    float x, y;
+    float r, g, b;
+};
+
+struct SpriteShape {
+    std::vector<float> triangles; // x, y pairs, 3 points per triangle
+
+    // a triangle fan (center first, then the outline in order, same as GL_TRIANGLE_FAN) as plain triangles
+    static SpriteShape fromFan(const std::vector<float>& fan) {
+        SpriteShape shape;
+        int points = (int)fan.size() / 2;
+        for (int i = 1; i + 1 < points; i++) {
+            shape.triangles.insert(shape.triangles.end(), { fan[0], fan[1], fan[i * 2], fan[i * 2 + 1], fan[i * 2 + 2], fan[i * 2 + 3] });
+        }
+        return shape;
+    }
+
+    // circle of radius 1
+    static SpriteShape circle(int segments) {
+        std::vector<float> fan = { 0.0f, 0.0f };
+        for (int i = 0; i <= segments; i++) {
+            float theta = 2.0f * 3.1415926f * float(i) / float(segments);
+            fan.push_back(cosf(theta));
+            fan.push_back(sinf(theta));
+        }
+        return fromFan(fan);
+    }
+
+    // ghost with a radius (half its width) of 1: a dome on top, straight sides and a zig-zag along the bottom
+    static SpriteShape ghost() {
+        int segments = 10;
+        float width = 2.0f;
+        float radius = 1.0f;
+
+        std::vector<float> fan = { 0.0f, 0.0f };
+        fan.insert(fan.end(), { -radius, radius }); // bottom left
+        fan.insert(fan.end(), { -radius, -radius }); // top left
+
+        // the top dome of the ghost
+        for (int i = 0; i <= segments; i++) {
+            float theta = 3.14159f + (float(i) / (float)segments) * 3.14159f;
+            fan.insert(fan.end(), { radius * cosf(theta), -radius + radius * sinf(theta) });
+        }
+
+        // bottom right endpoint of the square
+        fan.insert(fan.end(), { radius, radius });
+
+        int numTriangles = 4;
+        int totalSteps = numTriangles * 2;
+        float stepWidth = width / (float)totalSteps;
+
+        // the zig-zag at the bottom
+        for (int i = 1; i <= totalSteps; i++) {
+            float x = radius - (i * stepWidth);
+            float y = (i % 2 != 0) ? (radius + (width / 5)) : radius;
+            fan.insert(fan.end(), { x, y });
+        }
+
+        // close the loop by ending at the same point we started with
+        fan.insert(fan.end(), { -radius, radius });
+
+        return fromFan(fan);
+    }
+};
+
+class SpriteBatch {
+    private:
+        std::vector<SpriteVertex> vertices;
+
+        int frameDrawCalls = 0;
+        long totalDrawCalls = 0;
+        long frames = 0;
+
+    public:
+        // start of a frame, forget last frame's vertices (keeps the memory)
+        void begin() {
+            vertices.clear();
+            frameDrawCalls = 0;
+        }
+
+        void add(const SpriteShape& shape, float x, float y, float scale, float r, float g, float b) {
+            const std::vector<float>& points = shape.triangles;
+            for (size_t i = 0; i < points.size(); i += 2) {
+                vertices.push_back({ x + points[i] * scale, y + points[i + 1] * scale, r, g, b });
+            }
+        }
+
+        // draws everything added since the last flush in one go
+        void flush() {
+            if (vertices.empty()) return;
+
+            glEnableClientState(GL_VERTEX_ARRAY);
+            glEnableClientState(GL_COLOR_ARRAY);
+            glVertexPointer(2, GL_FLOAT, sizeof(SpriteVertex), &vertices[0].x);
+            glColorPointer(3, GL_FLOAT, sizeof(SpriteVertex), &vertices[0].r);
+
+            glDrawArrays(GL_TRIANGLES, 0, (GLsizei)vertices.size());
+            frameDrawCalls++;
+            totalDrawCalls++;
+
+            glDisableClientState(GL_COLOR_ARRAY);
+            glDisableClientState(GL_VERTEX_ARRAY);
+            vertices.clear();
+        }
+
+        // end of a frame, draws whatever's left
+        void end() {
+            flush();
+            frames++;
+        }
+
+        int drawCallsThisFrame() const {
+            return frameDrawCalls;
+        }
+
+        double drawCallsPerFrame() const {
+            return frames ? (double)totalDrawCalls / frames : 0.0;
+        }
+};
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <GLFW/glfw3.h>
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <cstdint>
+#include <cstdlib>
+#include <cmath>
+#include <iostream>
+
+#include "heightmap.h"
+#include "parallel.h"
+
+// data driven biomes
+// a biome covers every height up to (and including) its maxHeight, checked in order, so the last one
+// catches everything above. instead of picking a color per quad per frame, we classify every vertex once
+// into a biome index and look the color up in a tiny table when drawing. changing the table only means
+// classifying again, none of the geometry has to be rebuilt
+//
+// the table can come from a text file, one biome per line:
+//   name maxHeight r g b
+// blank lines and lines starting with # are skipped, maxHeight can be inf
+
+struct Biome {
+    std::string name;
+    float maxHeight;
+    float color[3];
+};
+
+class BiomeTable {
+    public:
+        std::vector<Biome> biomes;
+
+        // bumped every time the table changes, so anything classified with an older table knows it's stale
+        int version = 0;
+
+        // the original five biomes
+        // AI generated code for colors
+        static BiomeTable defaults() {
+            BiomeTable table;
+            table.biomes = {
+                { "water", 0.5f, { 0.0f, 0.0f, 1.0f } },         // Water Blue
+                { "valley", 6.0f, { 0.1f, 0.4f, 0.1f } },        // Very Dark Green
+                { "lowlands", 24.0f, { 0.34f, 0.7f, 0.3f } },    // Grass Green
+                { "peaks", 30.0f, { 0.45f, 0.38f, 0.26f } },     // Mountain Rock Brown
+                { "snow", 1e30f, { 0.95f, 0.95f, 1.0f } }        // Snow Caps (only for the very highest points)
+            };
+            return table;
+        }
+
+        // replaces the biomes with the ones in the file, leaves them alone if the file can't be used
+        bool loadFromFile(const std::string& path) {
+            std::ifstream file(path);
+            if (!file) {
+                std::cerr << "Couldn't open biome file " << path << "\n";
+                return false;
+            }
+
+            std::vector<Biome> loaded;
+            std::string line;
+            int lineNumber = 0;
+            while (std::getline(file, line)) {
+                lineNumber++;
+
+                std::istringstream stream(line);
+                std::string name, maxHeight;
+                if (!(stream >> name) || name[0] == '#') continue;
+
+                Biome biome;
+                biome.name = name;
+                if (!(stream >> maxHeight >> biome.color[0] >> biome.color[1] >> biome.color[2])) {
+                    std::cerr << path << ":" << lineNumber << ": expected name maxHeight r g b\n";
+                    return false;
+                }
+
+                // strtof understands inf, operator>> doesn't
+                // (a typo has to fail though, 0 would quietly move the biome to the front of the table)
+                char* end = nullptr;
+                biome.maxHeight = std::strtof(maxHeight.c_str(), &end);
+                if (end == maxHeight.c_str() || *end != '\0' || std::isnan(biome.maxHeight)) {
+                    std::cerr << path << ":" << lineNumber << ": bad maxHeight " << maxHeight << "\n";
+                    return false;
+                }
+                loaded.push_back(biome);
+            }
+
+            if (loaded.empty() || loaded.size() > 255) {
+                std::cerr << path << ": need between 1 and 255 biomes\n";
+                return false;
+            }
+
+            biomes = loaded;
+            version++;
+            return true;
+        }
+
+        uint8_t classify(float height) const {
+            for (size_t i = 0; i + 1 < biomes.size(); i++) {
+                if (height <= biomes[i].maxHeight) return i;
+            }
+            return biomes.size() - 1;
+        }
+
+        const float* color(uint8_t biome) const {
+            return biomes[biome].color;
+        }
+
+        void setColor(uint8_t biome, float diffuse) const {
+            const float* c = biomes[biome].color;
+            glColor3f(c[0] * diffuse, c[1] * diffuse, c[2] * diffuse);
+        }
+};
+
+// per vertex biome indices, same [x][z] layout as the heightmap
+inline void classifyBiomes(const Heightmap& heights, const BiomeTable& table, std::vector<uint8_t>& biomes, int threadCount = defaultThreadCount()) {
+    biomes.resize((size_t)heights.width * heights.depth);
+
+    parallelFor(heights.width, threadCount, [&](int x) {
+        uint8_t* row = &biomes[(size_t)x * heights.depth];
+        for (int z = 0; z < heights.depth; z++) {
+            row[z] = table.classify(heights.get(x, z));
+        }
+    });
+}
+
+// reclassifies just the vertices in region, for when only part of the heights changed
+inline void classifyBiomes(const Heightmap& heights, const BiomeTable& table, std::vector<uint8_t>& biomes, const HeightmapRegion& region) {
+    for (int x = region.x0; x < region.x1; x++) {
+        uint8_t* row = &biomes[(size_t)x * heights.depth];
+        for (int z = region.z0; z < region.z1; z++) {
+            row[z] = table.classify(heights.get(x, z));
+        }
+    }
+}
@@ -0,0 +1,297 @@
+#pragma once
+
+#include <vector>
+#include <cmath>
+#include <cstdint>
+#include <chrono>
+#include <algorithm>
+
+#include "heightmap.h"
+#include "parallel.h"
+#include "noise.h"
+
+// erosion, run a little at a time on top of the generated terrain
+//
+// hydraulic: droplets spawn at random spots and roll downhill, picking up sediment when they speed up
+// and dropping it when they slow down or fill up, which carves gullies and leaves fans at the bottom
+// thermal: anything steeper than the talus slope slides down onto its lower neighbors
+//
+// both give the same heights no matter how many threads run them:
+// droplets are split into tiles that never touch each other's vertices (a droplet that would leave its tile
+// just stops there), each tile runs its droplets in a fixed order with hashed random numbers, and the tile
+// grid is shifted every slice so the tile borders don't leave lines in the terrain.
+// thermal erosion is a gather over a double buffer, every vertex only writes itself
+//
+// needs float heights (HEIGHTS_FLOAT), the thermal pass works on the raw rows
+//
+// a slice is done in small steps (a batch of tiles, or a band of rows for the thermal pass) so one frame
+// never has to wait for a whole slice, and the heights are usable between any two steps.
+// every step says which vertices it changed, so whatever draws the terrain only has to catch up on those
+
+struct ErosionSettings {
+    // hydraulic
+    int tileSize = 64;              // droplets never leave their tile during a slice
+    int dropletsPerTile = 48;       // per tile per slice
+    int dropletLifetime = 30;       // steps, a droplet moves at most one cell per step
+    float inertia = 0.05f;          // how much a droplet keeps going the way it was going
+    float capacity = 4.0f;          // sediment capacity per unit of speed * water * drop
+    float minCapacity = 0.01f;
+    float erodeSpeed = 0.3f;
+    float depositSpeed = 0.3f;
+    float evaporation = 0.02f;
+    float gravity = 4.0f;
+
+    // thermal
+    float talus = 1.2f;             // biggest height difference between neighbors that stays put
+    float thermalRate = 0.05f;      // fraction of the excess that moves per pass (has to stay under 1/16)
+
+    int slices = 200;               // each slice is one round of droplets and one thermal pass
+    uint32_t seed = 1;
+};
+
+class TerrainErosion {
+    private:
+        Heightmap& terrain;
+        Heightmap scratch;
+        ErosionSettings settings;
+        int threadCount;
+        int slice = 0;
+
+        // where we are inside the current slice
+        enum Phase { HYDRAULIC, THERMAL };
+        Phase phase = HYDRAULIC;
+        int progress = 0; // next tile / next row
+
+        // items per step, a few per thread so uneven tiles still balance out
+        int batchSize() const { return threadCount * 4; }
+        int bandRows() const { return threadCount * 16; }
+
+        // height and gradient at a point between vertices
+        void sample(float px, float pz, float& height, float& gradX, float& gradZ) const {
+            int x = (int)px, z = (int)pz;
+            float fx = px - x, fz = pz - z;
+
+            float h00 = terrain.get(x, z), h10 = terrain.get(x + 1, z);
+            float h01 = terrain.get(x, z + 1), h11 = terrain.get(x + 1, z + 1);
+
+            gradX = (h10 - h00) * (1 - fz) + (h11 - h01) * fz;
+            gradZ = (h01 - h00) * (1 - fx) + (h11 - h10) * fx;
+            height = h00 * (1 - fx) * (1 - fz) + h10 * fx * (1 - fz) + h01 * (1 - fx) * fz + h11 * fx * fz;
+        }
+
+        // adds amount (negative to remove) to the 4 vertices around a point, split bilinearly
+        void spread(float px, float pz, float amount) {
+            int x = (int)px, z = (int)pz;
+            float fx = px - x, fz = pz - z;
+
+            terrain.set(x, z, terrain.get(x, z) + amount * (1 - fx) * (1 - fz));
+            terrain.set(x + 1, z, terrain.get(x + 1, z) + amount * fx * (1 - fz));
+            terrain.set(x, z + 1, terrain.get(x, z + 1) + amount * (1 - fx) * fz);
+            terrain.set(x + 1, z + 1, terrain.get(x + 1, z + 1) + amount * fx * fz);
+        }
+
+        // one droplet, the cell it's in has to stay inside [x0, x1) x [z0, z1) (cells, so it only touches
+        // vertices x0..x1 / z0..z1)
+        void runDroplet(float px, float pz, int x0, int z0, int x1, int z1) {
+            float dirX = 0.0f, dirZ = 0.0f;
+            float speed = 1.0f, water = 1.0f, sediment = 0.0f;
+
+            for (int step = 0; step < settings.dropletLifetime; step++) {
+                float height, gradX, gradZ;
+                sample(px, pz, height, gradX, gradZ);
+
+                dirX = dirX * settings.inertia - gradX * (1 - settings.inertia);
+                dirZ = dirZ * settings.inertia - gradZ * (1 - settings.inertia);
+                float length = std::sqrt(dirX * dirX + dirZ * dirZ);
+                if (length < 1e-6f) break; // flat, nowhere to go
+                dirX /= length;
+                dirZ /= length;
+
+                float nextX = px + dirX, nextZ = pz + dirZ;
+                if (nextX < x0 || nextZ < z0 || nextX >= x1 || nextZ >= z1) {
+                    // leaving the tile, drop everything here so no material goes missing
+                    spread(px, pz, sediment);
+                    return;
+                }
+
+                float nextHeight, unusedX, unusedZ;
+                sample(nextX, nextZ, nextHeight, unusedX, unusedZ);
+                float drop = nextHeight - height;
+
+                float capacity = std::max(-drop * speed * water * settings.capacity, settings.minCapacity);
+                if (drop > 0 || sediment > capacity) {
+                    // uphill fills the hole we came from (as far as the sediment goes), otherwise drop the excess
+                    float amount = (drop > 0) ? std::min(drop, sediment) : (sediment - capacity) * settings.depositSpeed;
+                    sediment -= amount;
+                    spread(px, pz, amount);
+                } else {
+                    // never dig deeper than the drop, that's what makes spikes
+                    float amount = std::min((capacity - sediment) * settings.erodeSpeed, -drop);
+                    sediment += amount;
+                    spread(px, pz, -amount);
+                }
+
+                speed = std::sqrt(std::max(0.0f, speed * speed - drop * settings.gravity));
+                water *= 1 - settings.evaporation;
+                px = nextX;
+                pz = nextZ;
+            }
+
+            spread(px, pz, sediment);
+        }
+
+        // runs count tiles of the current slice starting at first, returns how many tiles the slice has
+        // the vertices the tiles cover get merged into changed
+        int hydraulicStep(int first, int count, HeightmapRegion& changed) {
+            int size = settings.tileSize;
+            int cellsX = terrain.width - 1, cellsZ = terrain.depth - 1;
+
+            // shift the tile grid around every slice
+            int offsetX = hashLattice(slice, 0, settings.seed) % size;
+            int offsetZ = hashLattice(slice, 1, settings.seed) % size;
+            int tilesX = (cellsX + offsetX + size - 1) / size;
+            int tilesZ = (cellsZ + offsetZ + size - 1) / size;
+
+            int total = tilesX * tilesZ;
+            count = std::max(0, std::min(count, total - first));
+
+            // the batch is a run of tiles down the columns, so its bounds are a band of at most a few columns
+            for (int tile = first; tile < first + count; tile++) {
+                HeightmapRegion covered;
+                covered.x0 = std::max(0, (tile / tilesZ) * size - offsetX);
+                covered.z0 = std::max(0, (tile % tilesZ) * size - offsetZ);
+                covered.x1 = std::min(cellsX, (tile / tilesZ + 1) * size - offsetX) + 1;
+                covered.z1 = std::min(cellsZ, (tile % tilesZ + 1) * size - offsetZ) + 1;
+                changed = changed.merged(covered);
+            }
+
+            parallelFor(count, threadCount, [&](int item) {
+                int tile = first + item;
+                int x0 = std::max(0, (tile / tilesZ) * size - offsetX);
+                int z0 = std::max(0, (tile % tilesZ) * size - offsetZ);
+                int x1 = std::min(cellsX, (tile / tilesZ + 1) * size - offsetX);
+                int z1 = std::min(cellsZ, (tile % tilesZ + 1) * size - offsetZ);
+
+                // x1 / z1 are shared with the next tile, so our droplets have to stay a cell short of them
+                x1--;
+                z1--;
+                if (x1 <= x0 || z1 <= z0) return;
+
+                for (int d = 0; d < settings.dropletsPerTile; d++) {
+                    uint32_t h = hashLattice(slice, tile * settings.dropletsPerTile + d, settings.seed + 1);
+                    float rx = (h & 0xFFFF) / 65536.0f;
+                    float rz = (h >> 16) / 65536.0f;
+                    runDroplet(x0 + rx * (x1 - x0), z0 + rz * (z1 - z0), x0, z0, x1, z1);
+                }
+            });
+
+            return total;
+        }
+
+        // writes rows [first, first + count) of the next thermal pass into scratch
+        void thermalStep(int first, int count) {
+            const float diagonalTalus = settings.talus * 1.41421356f;
+            const float rate = settings.thermalRate;
+
+            // what moves between two neighbors only depends on the pair, so whatever one vertex loses
+            // the other one gains, and both can work it out on their own without writing to each other
+            count = std::max(0, std::min(count, terrain.width - first));
+            parallelFor(count, threadCount, [&](int item) {
+                int x = first + item;
+                const int depth = terrain.depth;
+                const float* rows[3] = {
+                    x > 0 ? terrain.data() + (size_t)(x - 1) * depth : nullptr,
+                    terrain.data() + (size_t)x * depth,
+                    x + 1 < terrain.width ? terrain.data() + (size_t)(x + 1) * depth : nullptr
+                };
+                float* out = scratch.data() + (size_t)x * depth;
+
+                for (int z = 0; z < depth; z++) {
+                    float height = rows[1][z];
+                    float change = 0.0f;
+                    int z0 = std::max(z - 1, 0), z1 = std::min(z + 1, depth - 1);
+
+                    for (int r = 0; r < 3; r++) {
+                        if (!rows[r]) continue;
+
+                        for (int nz = z0; nz <= z1; nz++) {
+                            if (r == 1 && nz == z) continue;
+
+                            float talus = (r != 1 && nz != z) ? diagonalTalus : settings.talus;
+                            float difference = height - rows[r][nz];
+                            change += (std::max(0.0f, -difference - talus) - std::max(0.0f, difference - talus)) * rate;
+                        }
+                    }
+
+                    out[z] = height + change;
+                }
+            });
+        }
+
+        // copies rows [first, last) of the thermal pass from scratch back into the terrain
+        void publishRows(int first, int last, HeightmapRegion& changed) {
+            first = std::max(first, 0);
+            if (last <= first) return;
+
+            std::copy(scratch.data() + (size_t)first * terrain.depth, scratch.data() + (size_t)last * terrain.depth,
+                terrain.data() + (size_t)first * terrain.depth);
+            changed = changed.merged({ first, 0, last, terrain.depth });
+        }
+
+        void step(HeightmapRegion& changed) {
+            if (phase == HYDRAULIC) {
+                int tiles = hydraulicStep(progress, batchSize(), changed);
+                progress += batchSize();
+                if (progress >= tiles) {
+                    phase = THERMAL;
+                    progress = 0;
+                }
+                return;
+            }
+
+            if (scratch.width != terrain.width || scratch.depth != terrain.depth) {
+                scratch.resize(terrain.width, terrain.depth);
+            }
+
+            int first = progress;
+            thermalStep(first, bandRows());
+            progress += bandRows();
+
+            // the band just done read the old heights one row either side of it, so the row before it can
+            // go back into the terrain now but its own last row has to wait for the next band
+            if (progress >= terrain.width) {
+                publishRows(first - 1, terrain.width, changed);
+                phase = HYDRAULIC;
+                progress = 0;
+                slice++;
+            } else {
+                publishRows(first - 1, progress - 1, changed);
+            }
+        }
+
+    public:
+        TerrainErosion(Heightmap& heights, const ErosionSettings& erosionSettings, int threads = defaultThreadCount())
+            : terrain(heights), settings(erosionSettings), threadCount(threads) {}
+
+        int completedSlices() const { return slice; }
+        int totalSlices() const { return settings.slices; }
+        bool finished() const { return slice >= settings.slices || terrain.width < 3 || terrain.depth < 3; }
+
+        // keeps stepping until the time budget is used up (always at least one step), returns the vertices
+        // whose heights changed, empty if there was nothing left to do
+        // a run also stops when the slice moves on to its other pass, that way the tiles and the row band
+        // never get merged into one region that covers most of the map
+        HeightmapRegion run(double budgetSeconds) {
+            HeightmapRegion changed;
+            if (finished()) return changed;
+
+            auto start = std::chrono::steady_clock::now();
+            Phase startPhase = phase;
+            do {
+                step(changed);
+            } while (!finished() && phase == startPhase
+                && std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() < budgetSeconds);
+
+            return changed;
+        }
+};
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <GLFW/glfw3.h>
+
+#include <cmath>
+
+// the six clipping planes of the current camera, pulled out of projection * modelview
+// (Gribb / Hartmann plane extraction), each plane is ax + by + cz + d with the normal pointing inside
+class Frustum {
+    public:
+        float planes[6][4];
+
+        // call this after the camera transforms are set up, the planes end up in the same space
+        // as whatever gets drawn next (terrain space for project3)
+        static Frustum fromCurrentMatrices() {
+            float projection[16], modelview[16], clip[16];
+            glGetFloatv(GL_PROJECTION_MATRIX, projection);
+            glGetFloatv(GL_MODELVIEW_MATRIX, modelview);
+
+            // both are column major, clip = projection * modelview
+            for (int column = 0; column < 4; column++) {
+                for (int row = 0; row < 4; row++) {
+                    float sum = 0.0f;
+                    for (int k = 0; k < 4; k++) {
+                        sum += projection[k * 4 + row] * modelview[column * 4 + k];
+                    }
+                    clip[column * 4 + row] = sum;
+                }
+            }
+
+            Frustum frustum;
+            for (int i = 0; i < 3; i++) {
+                for (int c = 0; c < 4; c++) {
+                    float w = clip[c * 4 + 3];
+                    float v = clip[c * 4 + i];
+                    frustum.planes[i * 2][c] = w + v;     // left, bottom, near
+                    frustum.planes[i * 2 + 1][c] = w - v; // right, top, far
+                }
+            }
+
+            for (auto& plane : frustum.planes) {
+                float length = std::sqrt(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]);
+                if (length > 0.0f) {
+                    for (float& value : plane) value /= length;
+                }
+            }
+
+            return frustum;
+        }
+
+        // false only when the box is completely outside one of the planes
+        // (boxes near the corners can still pass, which is fine for culling)
+        bool intersectsBox(float minX, float minY, float minZ, float maxX, float maxY, float maxZ) const {
+            for (const auto& plane : planes) {
+                // the corner furthest along the plane normal
+                float x = plane[0] >= 0.0f ? maxX : minX;
+                float y = plane[1] >= 0.0f ? maxY : minY;
+                float z = plane[2] >= 0.0f ? maxZ : minZ;
+
+                if (plane[0] * x + plane[1] * y + plane[2] * z + plane[3] < 0.0f) {
+                    return false;
+                }
+            }
+
+            return true;
+        }
+};
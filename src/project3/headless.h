@@ -0,0 +1,236 @@
+#pragma once
+
+#include <cstdio>
+#include <cstdint>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <iostream>
+
+#ifdef _WIN32
+    #ifndef NOMINMAX
+        #define NOMINMAX
+    #endif
+    #ifndef WIN32_LEAN_AND_MEAN
+        #define WIN32_LEAN_AND_MEAN
+    #endif
+    // version 2 maps GetProcessMemoryInfo to K32GetProcessMemoryInfo in kernel32, so no -lpsapi needed
+    #ifndef PSAPI_VERSION
+        #define PSAPI_VERSION 2
+    #endif
+    #include <windows.h>
+    #include <psapi.h>
+#else
+    #include <sys/resource.h>
+#endif
+
+#include "heightmap.h"
+#include "biome.h"
+#include "terrain_generator.h"
+#include "terrain_mesh.h"
+#include "heightmap_cache.h"
+#include "mesh_export.h"
+#include "terrain_export.h"
+#include "terrain_raytrace.h"
+
+// the terrain pipeline without a window, for timing it on big grids
+// every stage prints its wall time, how many grid cells it got through per second and the peak memory
+// of the whole process so far (the os only keeps the peak, so a stage that uses less than an earlier one
+// shows the same number)
+
+// peak resident set size of the process so far, in bytes (0 if we can't tell)
+inline size_t peakResidentBytes() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+        return counters.PeakWorkingSetSize;
+    }
+    return 0;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+    #ifdef __APPLE__
+        return (size_t)usage.ru_maxrss;        // bytes on mac
+    #else
+        return (size_t)usage.ru_maxrss * 1024; // kilobytes on linux
+    #endif
+#endif
+}
+
+struct HeadlessOptions {
+    int width = 256;
+    int depth = 256;
+    uint32_t seed = 1;
+    int smoothingPasses = 1;
+    int smoothingTileSize = 256;
+    int threadCount = 1;
+    HeightStorage heightStorage = HEIGHTS_FLOAT;
+    bool buildMesh = true;
+    MeshOrder meshOrder = MESH_ROWS; // forsyth is far too slow on the big grids
+    bool csv = false;
+    std::string heightsPath; // .p3hm, empty to skip
+    std::string meshPath;    // .obj, empty to skip
+    std::string exportPath;  // .ply / .glb / .gltf straight from the heights, empty to skip
+    std::string renderPath;  // .bmp from the raytracer, empty to skip
+    RaytraceOptions render;
+    BiomeTable biomeTable = BiomeTable::defaults(); // what --biomes loaded, so the colors match the window
+    float lightDirection[3] = { 0.0f, 1.0f, 0.0f };  // main.cpp hands over the window's light
+};
+
+class StageTimer {
+    private:
+        const HeadlessOptions& options;
+        std::chrono::steady_clock::time_point start;
+        std::string name;
+
+    public:
+        StageTimer(const HeadlessOptions& headlessOptions) : options(headlessOptions) {
+            if (options.csv) {
+                std::cout << "stage,grid,seconds,cells_per_second,peak_rss_bytes" << std::endl;
+            } else {
+                std::cout << "Terrain pipeline, " << options.width << " x " << options.depth << " grid, "
+                    << options.threadCount << " thread" << (options.threadCount == 1 ? "" : "s") << ", "
+                    << (options.heightStorage == HEIGHTS_COMPACT ? "16 bit" : "float") << " heights ("
+                    << (double)options.width * options.depth * (options.heightStorage == HEIGHTS_COMPACT ? 2 : 4) / (1024.0 * 1024.0)
+                    << " MB)" << std::endl;
+            }
+        }
+
+        void begin(const std::string& stageName) {
+            name = stageName;
+            start = std::chrono::steady_clock::now();
+        }
+
+        // cells is how many grid cells the stage processed (passes * cells for smoothing)
+        void end(double cells) {
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            double cellsPerSecond = seconds > 0 ? cells / seconds : 0;
+            size_t peak = peakResidentBytes();
+
+            if (options.csv) {
+                std::cout << name << "," << options.width << "x" << options.depth << "," << seconds << ","
+                    << cellsPerSecond << "," << peak << std::endl;
+                return;
+            }
+
+            char line[160];
+            std::snprintf(line, sizeof(line), "  %-10s %10.1f ms %10.2f Mcells/s %10.1f MB peak RSS",
+                name.c_str(), seconds * 1000.0, cellsPerSecond / 1e6, peak / (1024.0 * 1024.0));
+            std::cout << line << std::endl;
+        }
+};
+
+// returns the process exit code
+inline int runHeadlessPipeline(const HeadlessOptions& options) {
+    double cells = (double)options.width * options.depth;
+    StageTimer timer(options);
+
+    Heightmap terrain(options.width, options.depth, options.heightStorage), smoothed(0, 0, options.heightStorage);
+
+    timer.begin("generate");
+    generateTerrainGrid(terrain, 0, 0, 1, options.seed, options.threadCount);
+    timer.end(cells);
+
+    timer.begin("smooth");
+    if (options.smoothingPasses > 0) {
+        smoothed.resize(options.width, options.depth);
+        smoothTerrainGridTiled(terrain, smoothed, options.smoothingPasses, options.smoothingTileSize, options.threadCount);
+        terrain.swap(smoothed);
+        smoothed = Heightmap();
+    }
+    timer.end(cells * options.smoothingPasses);
+
+    {
+        // nothing keeps the normals, so they only get summed per row instead of stored
+        // (a full normal grid would be 3GB at 16k x 16k)
+        std::vector<float> rowSums(options.width);
+
+        timer.begin("normals");
+        parallelFor(options.width, options.threadCount, [&](int x) {
+            float sum = 0.0f;
+            for (int z = 0; z < options.depth; z++) {
+                float normalX, normalY, normalZ;
+                calculateHeightmapNormalAt(terrain, x, z, normalX, normalY, normalZ);
+                sum += normalX + normalY + normalZ;
+            }
+            rowSums[x] = sum;
+        });
+        timer.end(cells);
+    }
+
+    std::vector<uint8_t> biomes;
+    const BiomeTable& table = options.biomeTable;
+    timer.begin("biomes");
+    classifyBiomes(terrain, table, biomes, options.threadCount);
+    timer.end(cells);
+
+    // a .p3hm doesn't say how the heights were stored, so rounded 16 bit heights would later load as if they were
+    // the real float terrain (main.cpp doesn't write its cache from compact heights for the same reason)
+    if (!options.heightsPath.empty() && options.heightStorage == HEIGHTS_COMPACT) {
+        std::cerr << "--out-heights needs float heights, not writing " << options.heightsPath << "\n";
+    } else if (!options.heightsPath.empty()) {
+        TerrainParams params;
+        params.width = options.width;
+        params.depth = options.depth;
+        params.seed = options.seed;
+        params.smoothingPasses = options.smoothingPasses;
+
+        timer.begin("write p3hm");
+        bool ok = saveHeightmapCache(options.heightsPath, params, terrain);
+        timer.end(cells);
+        if (!ok) {
+            std::cerr << "Couldn't write " << options.heightsPath << "\n";
+            return 1;
+        }
+    }
+
+    const float* light = options.lightDirection;
+
+    if (!options.exportPath.empty()) {
+        timer.begin("export");
+        bool ok = exportTerrain(options.exportPath, terrain, table, light);
+        timer.end(cells);
+        if (!ok) {
+            std::cerr << "Couldn't export " << options.exportPath << "\n";
+            return 1;
+        }
+    }
+
+    if (!options.renderPath.empty()) {
+        HeightmapPyramid pyramid;
+        timer.begin("pyramid");
+        pyramid.build(terrain, options.threadCount);
+        timer.end(cells);
+
+        // cells per second doesn't mean much for a picture, this one counts pixels
+        RaytraceOptions render = options.render;
+        render.threadCount = options.threadCount;
+        std::vector<uint8_t> rgb;
+        timer.begin("raytrace");
+        raytraceTerrain(terrain, pyramid, table, light, render, rgb);
+        timer.end((double)render.width * render.height);
+
+        if (!writeImageBmp(options.renderPath, render.width, render.height, rgb)) {
+            std::cerr << "Couldn't write " << options.renderPath << "\n";
+            return 1;
+        }
+    }
+
+    if (options.buildMesh) {
+        timer.begin("mesh");
+        TerrainMesh mesh = buildTerrainMesh(terrain, biomes, table, 0, 0, options.width - 1, options.depth - 1, options.meshOrder, light);
+        timer.end(cells);
+
+        if (!options.meshPath.empty()) {
+            timer.begin("write obj");
+            bool ok = writeMeshObj(options.meshPath, mesh);
+            timer.end(cells);
+            if (!ok) {
+                std::cerr << "Couldn't write " << options.meshPath << "\n";
+                return 1;
+            }
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,230 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <cmath>
+#include <cstddef>
+#include <algorithm>
+#include <utility>
+#include <cstdint>
+
+// how a heightmap keeps its heights
+// compact is 16 bits per height (unorm16 over compactHeightMin..compactHeightMax), half the memory of floats
+// for a step of about 0.004 units, which is far below anything you can see. get / set convert on the way
+// in and out, so everything that goes through them works the same on either
+enum HeightStorage {
+    HEIGHTS_FLOAT,
+    HEIGHTS_COMPACT
+};
+
+const float compactHeightMin = -128.0f;
+const float compactHeightMax = 128.0f;
+const float compactHeightStep = (compactHeightMax - compactHeightMin) / 65535.0f;
+
+// flat height storage for the terrain grid
+// indexed [x][z] the same way the old nested yCoords vectors were, but kept in one block
+// so big grids (16k x 16k) are a single allocation instead of 16k separate ones
+// the heights either live in our own vector or somewhere we don't own (like a memory mapped cache file),
+// externalStorage keeps that somewhere alive for as long as we point into it
+class Heightmap {
+    private:
+        std::vector<float> heights;
+        float* values = nullptr;
+        std::shared_ptr<void> externalStorage;
+        std::vector<uint16_t> compact; // only used with HEIGHTS_COMPACT, values is null then
+        HeightStorage storage = HEIGHTS_FLOAT;
+
+        static uint16_t quantize(float height) {
+            float q = (height - compactHeightMin) / compactHeightStep + 0.5f;
+            return (uint16_t)std::min(std::max(q, 0.0f), 65535.0f);
+        }
+
+    public:
+        int width = 0; // number of vertices along x
+        int depth = 0; // number of vertices along z
+
+        Heightmap() {}
+        Heightmap(int width, int depth, HeightStorage heightStorage = HEIGHTS_FLOAT) : storage(heightStorage) { resize(width, depth); }
+
+        // copies always end up owning their heights, even if the source was mapped
+        Heightmap(const Heightmap& other) { *this = other; }
+        Heightmap& operator=(const Heightmap& other) {
+            if (this != &other) {
+                width = other.width;
+                depth = other.depth;
+                storage = other.storage;
+                if (storage == HEIGHTS_COMPACT) {
+                    std::vector<float>().swap(heights);
+                    compact = other.compact;
+                    values = nullptr;
+                } else {
+                    std::vector<uint16_t>().swap(compact);
+                    heights.assign(other.values, other.values + (size_t)other.width * other.depth);
+                    values = heights.data();
+                }
+                externalStorage.reset();
+            }
+            return *this;
+        }
+
+        Heightmap(Heightmap&& other) noexcept { swap(other); }
+        Heightmap& operator=(Heightmap&& other) noexcept {
+            swap(other);
+            return *this;
+        }
+
+        // keeps the current storage
+        void resize(int w, int d) {
+            width = w;
+            depth = d;
+            externalStorage.reset();
+            if (storage == HEIGHTS_COMPACT) {
+                std::vector<float>().swap(heights);
+                compact.assign((size_t)w * d, quantize(0.0f));
+                values = nullptr;
+            } else {
+                heights.assign((size_t)w * d, 0.0f);
+                values = heights.data();
+            }
+        }
+
+        // switches storage, converting whatever heights are already there
+        void setStorage(HeightStorage heightStorage) {
+            if (heightStorage == storage) return;
+
+            size_t count = (size_t)width * depth;
+            if (heightStorage == HEIGHTS_COMPACT) {
+                compact.resize(count);
+                for (size_t i = 0; i < count; i++) compact[i] = quantize(values[i]);
+                std::vector<float>().swap(heights);
+                values = nullptr;
+            } else {
+                heights.resize(count);
+                for (size_t i = 0; i < count; i++) heights[i] = compactHeightMin + compact[i] * compactHeightStep;
+                std::vector<uint16_t>().swap(compact);
+                values = heights.data();
+            }
+            externalStorage.reset();
+            storage = heightStorage;
+        }
+
+        HeightStorage storageType() const { return storage; }
+
+        // point at w * d heights somewhere else, owner is whatever keeps that memory valid
+        // (always float, that's what the cache file has)
+        void adopt(float* data, int w, int d, std::shared_ptr<void> owner) {
+            std::vector<float>().swap(heights);
+            std::vector<uint16_t>().swap(compact);
+            storage = HEIGHTS_FLOAT;
+            width = w;
+            depth = d;
+            values = data;
+            externalStorage = std::move(owner);
+        }
+
+        float get(int x, int z) const {
+            size_t i = (size_t)x * depth + z;
+            return values ? values[i] : compactHeightMin + compact[i] * compactHeightStep;
+        }
+
+        void set(int x, int z, float height) {
+            size_t i = (size_t)x * depth + z;
+            if (values) {
+                values[i] = height;
+            } else {
+                compact[i] = quantize(height);
+            }
+        }
+
+        // a whole row (one x, every z) at once, works for both storages
+        void getRow(int x, float* out) const {
+            if (values) {
+                std::copy(values + (size_t)x * depth, values + (size_t)(x + 1) * depth, out);
+                return;
+            }
+            const uint16_t* row = compact.data() + (size_t)x * depth;
+            for (int z = 0; z < depth; z++) out[z] = compactHeightMin + row[z] * compactHeightStep;
+        }
+
+        void setRow(int x, const float* row) {
+            if (values) {
+                std::copy(row, row + depth, values + (size_t)x * depth);
+                return;
+            }
+            uint16_t* out = compact.data() + (size_t)x * depth;
+            for (int z = 0; z < depth; z++) out[z] = quantize(row[z]);
+        }
+
+        // the raw floats, null for compact storage (use get / set / getRow / setRow there)
+        float* data() { return values; }
+        const float* data() const { return values; }
+
+        size_t sizeInBytes() const {
+            return (size_t)width * depth * (storage == HEIGHTS_COMPACT ? sizeof(uint16_t) : sizeof(float));
+        }
+
+        void swap(Heightmap& other) {
+            heights.swap(other.heights);
+            std::swap(values, other.values);
+            externalStorage.swap(other.externalStorage);
+            compact.swap(other.compact);
+            std::swap(storage, other.storage);
+            std::swap(width, other.width);
+            std::swap(depth, other.depth);
+        }
+};
+
+// a rectangle of grid vertices, [x0, x1) x [z0, z1)
+// used to say which part of a heightmap changed so only that part has to be redone
+struct HeightmapRegion {
+    int x0 = 0, z0 = 0, x1 = 0, z1 = 0;
+
+    bool empty() const { return x1 <= x0 || z1 <= z0; }
+
+    bool overlaps(const HeightmapRegion& other) const {
+        return x0 < other.x1 && other.x0 < x1 && z0 < other.z1 && other.z0 < z1;
+    }
+
+    // grown by amount in every direction, but never past the edges of a width x depth grid
+    HeightmapRegion expanded(int amount, int width, int depth) const {
+        HeightmapRegion region;
+        region.x0 = std::max(x0 - amount, 0);
+        region.z0 = std::max(z0 - amount, 0);
+        region.x1 = std::min(x1 + amount, width);
+        region.z1 = std::min(z1 + amount, depth);
+        return region;
+    }
+
+    // smallest region covering both
+    HeightmapRegion merged(const HeightmapRegion& other) const {
+        if (empty()) return other;
+        if (other.empty()) return *this;
+
+        HeightmapRegion region;
+        region.x0 = std::min(x0, other.x0);
+        region.z0 = std::min(z0, other.z0);
+        region.x1 = std::max(x1, other.x1);
+        region.z1 = std::max(z1, other.z1);
+        return region;
+    }
+};
+
+// forward difference normal over a cell of size step
+// step is 1 for the full resolution grid, and 2, 4, 8... for the coarser lod levels
+inline void calculateHeightmapNormal(float heightL, float heightR, float heightD, float step, float& normalX, float& normalY, float& normalZ) {
+    normalX = -(heightR - heightL) / step;
+    normalY = 1.0f;
+    normalZ = -(heightD - heightL) / step;
+
+    float length = std::sqrt(normalX * normalX + normalY * normalY + normalZ * normalZ);
+    normalX /= length;
+    normalY /= length;
+    normalZ /= length;
+}
+
+// normal of a grid vertex, the last row / column reuses the difference from the one before it
+inline void calculateHeightmapNormalAt(const Heightmap& heights, int x, int z, float& normalX, float& normalY, float& normalZ) {
+    int x0 = std::min(x, heights.width - 2), z0 = std::min(z, heights.depth - 2);
+    float heightL = heights.get(x0, z0);
+    calculateHeightmapNormal(heightL, heights.get(x0 + 1, z0), heights.get(x0, z0 + 1), 1.0f, normalX, normalY, normalZ);
+}
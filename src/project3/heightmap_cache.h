@@ -0,0 +1,226 @@
+#pragma once
+
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <memory>
+#include <vector>
+
+#ifdef _WIN32
+    #ifndef NOMINMAX
+        #define NOMINMAX
+    #endif
+    #ifndef WIN32_LEAN_AND_MEAN
+        #define WIN32_LEAN_AND_MEAN
+    #endif
+    #include <windows.h>
+#else
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <fcntl.h>
+    #include <unistd.h>
+#endif
+
+#include "heightmap.h"
+#include "terrain_generator.h"
+
+// on disk cache for the generated terrain so we don't regenerate + smooth it on every launch
+//
+// file layout (native byte order, everything after the header is 64 byte aligned):
+//   HeightmapFileHeader
+//   width * depth floats of heights, [x][z] order like Heightmap
+//
+// normals aren't kept, the mesh and lod paths work them out from the heights as they go anyway
+//
+// the file gets memory mapped copy-on-write, so loading is just pointing the Heightmap at the mapping,
+// nothing gets parsed or copied, and editing the heights later never writes back into the file
+
+const char heightmapFileMagic[4] = { 'P', '3', 'H', 'M' };
+const uint32_t heightmapFileVersion = 2;
+
+// everything that changes what the generated terrain looks like
+struct TerrainParams {
+    uint32_t width = 0;
+    uint32_t depth = 0;
+    uint32_t seed = 0;
+    uint32_t smoothingPasses = 0;
+    float floorHeight = terrainFloorHeight;
+    uint32_t generatorVersion = terrainGeneratorVersion;
+
+    // fnv-1a over the fields (and the file version), if it doesn't match the file is stale
+    uint64_t hash() const {
+        uint64_t h = 14695981039346656037ull;
+        auto mix = [&h](const void* data, size_t size) {
+            const uint8_t* bytes = (const uint8_t*)data;
+            for (size_t i = 0; i < size; i++) {
+                h ^= bytes[i];
+                h *= 1099511628211ull;
+            }
+        };
+
+        mix(&heightmapFileVersion, sizeof(heightmapFileVersion));
+        mix(&width, sizeof(width));
+        mix(&depth, sizeof(depth));
+        mix(&seed, sizeof(seed));
+        mix(&smoothingPasses, sizeof(smoothingPasses));
+        mix(&floorHeight, sizeof(floorHeight));
+        mix(&generatorVersion, sizeof(generatorVersion));
+        return h;
+    }
+};
+
+struct HeightmapFileHeader {
+    char magic[4];
+    uint32_t version;
+    TerrainParams params;
+    uint64_t paramsHash;
+    uint32_t flags;
+    uint32_t reserved;
+    uint64_t heightsOffset;
+};
+
+const size_t heightmapFileAlignment = 64;
+static_assert(sizeof(HeightmapFileHeader) <= heightmapFileAlignment, "header has to fit before the height data");
+
+// a read only file mapped copy-on-write into memory
+class MappedFile {
+    private:
+#ifdef _WIN32
+        HANDLE file = INVALID_HANDLE_VALUE;
+        HANDLE mapping = NULL;
+#endif
+        uint8_t* base = nullptr;
+        size_t length = 0;
+
+    public:
+        MappedFile() {}
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        ~MappedFile() {
+#ifdef _WIN32
+            if (base) UnmapViewOfFile(base);
+            if (mapping) CloseHandle(mapping);
+            if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+#else
+            if (base) munmap(base, length);
+#endif
+        }
+
+        uint8_t* data() const { return base; }
+        size_t size() const { return length; }
+
+        // nullptr if the file doesn't exist or can't be mapped
+        static std::shared_ptr<MappedFile> open(const std::string& path) {
+            std::shared_ptr<MappedFile> mapped(new MappedFile());
+
+#ifdef _WIN32
+            mapped->file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+            if (mapped->file == INVALID_HANDLE_VALUE) return nullptr;
+
+            LARGE_INTEGER fileSize;
+            if (!GetFileSizeEx(mapped->file, &fileSize) || fileSize.QuadPart == 0) return nullptr;
+            mapped->length = (size_t)fileSize.QuadPart;
+
+            mapped->mapping = CreateFileMappingA(mapped->file, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+            if (!mapped->mapping) return nullptr;
+
+            mapped->base = (uint8_t*)MapViewOfFile(mapped->mapping, FILE_MAP_COPY, 0, 0, 0);
+            if (!mapped->base) return nullptr;
+#else
+            int fd = ::open(path.c_str(), O_RDONLY);
+            if (fd < 0) return nullptr;
+
+            struct stat info;
+            if (fstat(fd, &info) != 0 || info.st_size == 0) {
+                close(fd);
+                return nullptr;
+            }
+            mapped->length = (size_t)info.st_size;
+
+            void* address = mmap(nullptr, mapped->length, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+            close(fd); // the mapping keeps its own reference to the file
+            if (address == MAP_FAILED) return nullptr;
+
+            mapped->base = (uint8_t*)address;
+#endif
+
+            return mapped;
+        }
+};
+
+inline uint64_t alignHeightmapOffset(uint64_t offset) {
+    return (offset + heightmapFileAlignment - 1) / heightmapFileAlignment * heightmapFileAlignment;
+}
+
+// maps the cache file into terrain if it's there and was made with the same params
+inline bool loadHeightmapCache(const std::string& path, const TerrainParams& params, Heightmap& terrain) {
+    std::shared_ptr<MappedFile> mapped = MappedFile::open(path);
+    if (!mapped || mapped->size() < sizeof(HeightmapFileHeader)) {
+        return false;
+    }
+
+    HeightmapFileHeader header;
+    std::memcpy(&header, mapped->data(), sizeof(header));
+
+    if (std::memcmp(header.magic, heightmapFileMagic, 4) != 0 || header.version != heightmapFileVersion) {
+        return false;
+    }
+    if (header.paramsHash != params.hash() || header.params.width != params.width || header.params.depth != params.depth) {
+        return false;
+    }
+
+    uint64_t cells = (uint64_t)params.width * params.depth;
+    if (header.heightsOffset % sizeof(float) != 0 || header.heightsOffset + cells * sizeof(float) > mapped->size()) {
+        return false;
+    }
+
+    float* heights = (float*)(mapped->data() + header.heightsOffset);
+    terrain.adopt(heights, params.width, params.depth, mapped);
+
+    return true;
+}
+
+// writes the terrain out, to a temp file first and then renamed over the old one so a crash
+// halfway through never leaves a broken cache behind
+inline bool saveHeightmapCache(const std::string& path, const TerrainParams& params, const Heightmap& terrain) {
+    uint64_t cells = (uint64_t)terrain.width * terrain.depth;
+
+    HeightmapFileHeader header = HeightmapFileHeader();
+    std::memcpy(header.magic, heightmapFileMagic, 4);
+    header.version = heightmapFileVersion;
+    header.params = params;
+    header.paramsHash = params.hash();
+    header.heightsOffset = alignHeightmapOffset(sizeof(header));
+
+    std::string tempPath = path + ".tmp";
+    FILE* file = std::fopen(tempPath.c_str(), "wb");
+    if (!file) {
+        return false;
+    }
+
+    std::vector<uint8_t> padding(heightmapFileAlignment, 0);
+    bool ok = std::fwrite(&header, sizeof(header), 1, file) == 1;
+    ok = ok && std::fwrite(padding.data(), 1, header.heightsOffset - sizeof(header), file) == header.heightsOffset - sizeof(header);
+    if (terrain.data()) {
+        ok = ok && std::fwrite(terrain.data(), sizeof(float), cells, file) == cells;
+    } else {
+        // compact heights go out as floats a row at a time, the file is always floats
+        std::vector<float> row(terrain.depth);
+        for (int x = 0; ok && x < terrain.width; x++) {
+            terrain.getRow(x, row.data());
+            ok = std::fwrite(row.data(), sizeof(float), row.size(), file) == row.size();
+        }
+    }
+
+    ok = (std::fclose(file) == 0) && ok;
+    if (!ok) {
+        std::remove(tempPath.c_str());
+        return false;
+    }
+
+    // rename doesn't replace an existing file on windows
+    std::remove(path.c_str());
+    return std::rename(tempPath.c_str(), path.c_str()) == 0;
+}
@@ -0,0 +1,228 @@
+#pragma once
+
+#include <vector>
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+
+#include "heightmap.h"
+#include "parallel.h"
+
+// the terrain at every power of two resolution, for anything that only needs a coarse answer
+// (lod bounds, culling, the raytracer's empty space skipping, overview images...)
+//
+// a node at level k covers 2^k x 2^k grid cells starting at (x << k, z << k) and keeps
+//   minimum / maximum: lowest and highest height of every vertex touching those cells (so the corners shared
+//                      with the next node count too, a cell never pokes out of its node's bounds)
+//   average:           mean height of the 2^k x 2^k vertices at its corner, nodes don't share those so each
+//                      level is a proper downsample of the one below (the last node in a row takes the leftover
+//                      last vertex too)
+//
+// levels 0 and 1 are never stored, they're a handful of heights away so they just get read off the heightmap.
+// storing from level 2 up costs 3 floats per 16 cells times 4/3 for the levels above, a quarter of the
+// heightmap itself. for compact heights the nodes are 16 bits on the same scale (minimum rounded down,
+// maximum rounded up so the bounds still never get tighter), which keeps it at a quarter
+//
+// the pyramid keeps a pointer to the heightmap, so it has to outlive its heights moving around
+// (call build again after a resize / swap / adopt, or update with the region that changed)
+
+struct HeightmapPyramidNode {
+    float minimum, maximum, average;
+};
+
+struct CompactPyramidNode {
+    uint16_t minimum, maximum, average;
+};
+
+class HeightmapPyramid {
+    private:
+        const Heightmap* heights = nullptr;
+        int cellsX = 0, cellsZ = 0;
+        int topLevel = 0;
+        bool compact = false; // same storage as the heights, only one of these is used
+        std::vector<std::vector<HeightmapPyramidNode>> stored; // stored[level - firstStoredLevel]
+        std::vector<std::vector<CompactPyramidNode>> storedCompact;
+
+        static constexpr int firstStoredLevel = 2;
+
+        static uint16_t quantize(float height, float rounding) {
+            float q = std::floor((height - compactHeightMin) / compactHeightStep + rounding);
+            return (uint16_t)std::min(std::max(q, 0.0f), 65535.0f);
+        }
+
+        static float unquantize(uint16_t q) {
+            return compactHeightMin + q * compactHeightStep;
+        }
+
+        HeightmapPyramidNode storedNode(int level, size_t index) const {
+            if (!compact) return stored[level - firstStoredLevel][index];
+
+            const CompactPyramidNode& q = storedCompact[level - firstStoredLevel][index];
+            return { unquantize(q.minimum), unquantize(q.maximum), unquantize(q.average) };
+        }
+
+        void store(int level, size_t index, const HeightmapPyramidNode& node) {
+            if (!compact) {
+                stored[level - firstStoredLevel][index] = node;
+                return;
+            }
+
+            // a tiny bit of slack so a height that's already on the grid doesn't get pushed a step out
+            storedCompact[level - firstStoredLevel][index] = { quantize(node.minimum, 0.01f), quantize(node.maximum, 0.99f), quantize(node.average, 0.5f) };
+        }
+
+        // first vertex after a node's average block
+        int averageEndX(int level, int x) const {
+            return (x == width(level) - 1) ? heights->width : (x + 1) << level;
+        }
+
+        int averageEndZ(int level, int z) const {
+            return (z == depth(level) - 1) ? heights->depth : (z + 1) << level;
+        }
+
+        HeightmapPyramidNode fromHeights(int level, int x, int z) const {
+            int x0 = x << level, z0 = z << level;
+            int x1 = std::min(x0 + (1 << level), heights->width - 1);
+            int z1 = std::min(z0 + (1 << level), heights->depth - 1);
+            int averageX = averageEndX(level, x), averageZ = averageEndZ(level, z);
+
+            HeightmapPyramidNode node = { INFINITY, -INFINITY, 0.0f };
+            double sum = 0.0;
+            for (int vx = x0; vx <= std::max(x1, averageX - 1); vx++) {
+                for (int vz = z0; vz <= std::max(z1, averageZ - 1); vz++) {
+                    float height = heights->get(vx, vz);
+                    if (vx <= x1 && vz <= z1) {
+                        node.minimum = std::min(node.minimum, height);
+                        node.maximum = std::max(node.maximum, height);
+                    }
+                    if (vx < averageX && vz < averageZ) sum += height;
+                }
+            }
+            node.average = (float)(sum / ((double)(averageX - x0) * (averageZ - z0)));
+            return node;
+        }
+
+        HeightmapPyramidNode fromChildren(int level, int x, int z) const {
+            HeightmapPyramidNode node = { INFINITY, -INFINITY, 0.0f };
+            double sum = 0.0, count = 0.0;
+            for (int cx = x * 2; cx < std::min(x * 2 + 2, width(level - 1)); cx++) {
+                for (int cz = z * 2; cz < std::min(z * 2 + 2, depth(level - 1)); cz++) {
+                    HeightmapPyramidNode child = storedNode(level - 1, (size_t)cx * depth(level - 1) + cz);
+                    double weight = (double)(averageEndX(level - 1, cx) - (cx << (level - 1))) * (averageEndZ(level - 1, cz) - (cz << (level - 1)));
+
+                    node.minimum = std::min(node.minimum, child.minimum);
+                    node.maximum = std::max(node.maximum, child.maximum);
+                    sum += child.average * weight;
+                    count += weight;
+                }
+            }
+            node.average = (float)(sum / count);
+            return node;
+        }
+
+        // recomputes nodes [x0, x1] x [z0, z1] of a stored level
+        void computeNodes(int level, int x0, int z0, int x1, int z1, int threadCount) {
+            int levelDepth = depth(level);
+
+            parallelFor(x1 - x0 + 1, threadCount, [&](int i) {
+                int x = x0 + i;
+                for (int z = z0; z <= z1; z++) {
+                    store(level, (size_t)x * levelDepth + z, (level == firstStoredLevel) ? fromHeights(level, x, z) : fromChildren(level, x, z));
+                }
+            });
+        }
+
+    public:
+        void build(const Heightmap& heightmap, int threadCount = defaultThreadCount()) {
+            heights = &heightmap;
+            cellsX = std::max(1, heights->width - 1);
+            cellsZ = std::max(1, heights->depth - 1);
+
+            topLevel = 0;
+            while ((1 << topLevel) < std::max(cellsX, cellsZ)) topLevel++;
+
+            compact = heights->storageType() == HEIGHTS_COMPACT;
+            stored.clear();
+            storedCompact.clear();
+            for (int level = firstStoredLevel; level <= topLevel; level++) {
+                if (compact) {
+                    storedCompact.emplace_back((size_t)width(level) * depth(level));
+                } else {
+                    stored.emplace_back((size_t)width(level) * depth(level));
+                }
+                computeNodes(level, 0, 0, width(level) - 1, depth(level) - 1, threadCount);
+            }
+        }
+
+        // redo the nodes that depend on the heights in region, region is in grid vertices
+        void update(const HeightmapRegion& region) {
+            if (!heights || region.empty()) return;
+
+            // a vertex touches the cells on both sides of it
+            int x0 = std::max(0, region.x0 - 1), z0 = std::max(0, region.z0 - 1);
+            int x1 = region.x1 - 1, z1 = region.z1 - 1;
+            for (int level = firstStoredLevel; level <= topLevel; level++) {
+                computeNodes(level, std::min(x0 >> level, width(level) - 1), std::min(z0 >> level, depth(level) - 1),
+                    std::min(x1 >> level, width(level) - 1), std::min(z1 >> level, depth(level) - 1), 1);
+            }
+        }
+
+        int levels() const {
+            return topLevel + 1;
+        }
+
+        // in nodes
+        int width(int level) const {
+            return ((cellsX - 1) >> level) + 1;
+        }
+
+        int depth(int level) const {
+            return ((cellsZ - 1) >> level) + 1;
+        }
+
+        HeightmapPyramidNode node(int level, int x, int z) const {
+            if (level < firstStoredLevel) return fromHeights(level, x, z);
+            return storedNode(level, (size_t)x * depth(level) + z);
+        }
+
+        // lowest and highest height in a region of grid vertices, never tighter than the real answer but it
+        // can be looser (it's the bounds of up to 2 x 2 nodes that cover the region)
+        void bounds(const HeightmapRegion& region, float& low, float& high) const {
+            low = INFINITY;
+            high = -INFINITY;
+            if (!heights || region.empty()) return;
+
+            // the smallest level where the region's cells fit inside 2 x 2 nodes
+            // (a region lined up with a node is exactly that node, since nodes include their far edge)
+            int extent = std::max({ region.x1 - region.x0 - 1, region.z1 - region.z0 - 1, 1 });
+            int level = 0;
+            while ((1 << level) < extent && level < topLevel) level++;
+
+            if (level < firstStoredLevel) {
+                for (int x = region.x0; x < region.x1; x++) {
+                    for (int z = region.z0; z < region.z1; z++) {
+                        low = std::min(low, heights->get(x, z));
+                        high = std::max(high, heights->get(x, z));
+                    }
+                }
+                return;
+            }
+
+            int x1 = std::min(std::max(region.x0, region.x1 - 2) >> level, width(level) - 1);
+            int z1 = std::min(std::max(region.z0, region.z1 - 2) >> level, depth(level) - 1);
+            for (int x = std::min(region.x0 >> level, x1); x <= x1; x++) {
+                for (int z = std::min(region.z0 >> level, z1); z <= z1; z++) {
+                    HeightmapPyramidNode covering = storedNode(level, (size_t)x * depth(level) + z);
+                    low = std::min(low, covering.minimum);
+                    high = std::max(high, covering.maximum);
+                }
+            }
+        }
+
+        size_t sizeInBytes() const {
+            size_t bytes = 0;
+            for (const auto& level : stored) bytes += level.size() * sizeof(HeightmapPyramidNode);
+            for (const auto& level : storedCompact) bytes += level.size() * sizeof(CompactPyramidNode);
+            return bytes;
+        }
+};
@@ -2,20 +2,70 @@
 
 #include <iostream>
 #include <vector>
-#include <random>
+#include <string>
+#include <cstdlib>
+#include <cstdio>
+#include <cerrno>
+#include <cstdint>
+#include <thread>
+#include <memory>
+#include <chrono>
+#include <algorithm>
+
+#include "heightmap.h"
+#include "biome.h"
+#include "terrain_generator.h"
+#include "terrain_lod.h"
+#include "terrain_stream.h"
+#include "heightmap_cache.h"
+#include "terrain_mesh.h"
+#include "erosion.h"
+#include "terrain_edit.h"
+#include "headless.h"
 
 const int windowWidth = 1920;
 const int windowHeight = 1080;
 
-const int gridWidth = 250;
-const int gridHeight = 250;
-
-const int maxHeight = gridHeight / 16;
-
-std::default_random_engine generator;
-std::uniform_real_distribution<> noiseDistribution(0.0, 5);
-
-std::vector<std::vector<float>> xCoords, yCoords, zCoords, smoothedYCoords;
+// grid size can be changed with --grid <size> on the command line
+int gridWidth = 250;
+int gridHeight = 250;
+
+// lod settings, chunks are chunkSize x chunkSize quads
+// and a chunk is split once its error on screen goes over maxScreenError pixels
+// (unless its cells would end up smaller than minCellPixels on screen)
+const int terrainChunkSize = 32;
+const float maxScreenError = 2.0f;
+const float minCellPixels = 2.0f;
+
+// how many degrees we rotate per frame while X/Y/Z is held
+const float rotationSpeed = 2.0f;
+
+// streaming (--stream) settings, tiles are tileSize x tileSize quads and we keep the ones
+// within streamRadius tiles of the camera loaded, the coarse preview uses every previewStep'th vertex
+const int streamTileSize = 128;
+const int streamRadius = 3;
+const int streamPreviewStep = 8;
+const float cameraSpeed = 4.0f;
+
+// seed for the terrain, the same seed always gives the same terrain
+uint32_t terrainSeed = 1;
+const int smoothingPasses = 1; // the fBm noise has no single cell jitter left to smooth out, one pass is plenty
+const int smoothingTileSize = 256;
+
+// how long erosion (--erode) gets per frame, the rest of the frame is for drawing
+const double erosionBudget = 0.008;
+
+// heights of the terrain, x / z are just the grid indices so we don't store them
+Heightmap terrain, smoothedTerrain;
+
+// biome of every terrain vertex (same [x][z] layout), filled in by classifyTerrainBiomes
+// the table comes from --biomes <file> or falls back to the built in one, B reloads the file
+BiomeTable biomeTable = BiomeTable::defaults();
+std::vector<uint8_t> terrainBiomes;
+
+uint8_t biomeAt(int x, int z) {
+    return terrainBiomes[(size_t)x * terrain.depth + z];
+}
 
 class Point {
     public:
@@ -25,19 +75,10 @@ class Point {
 };
 
 Point calculateVectorNormal(int x, int z) {
-    float heightL = yCoords[x][z];
-    float heightR = yCoords[x + 1][z];
-    float heightD = yCoords[x][z + 1];
-
-    // calculate the cross product
-    float normalX = -(heightR - heightL);
-    float normalY = 1.0f;
-    float normalZ = -(heightD - heightL);
-
-    // normalize the normal vector
-    float length = sqrt(normalX * normalX + normalY * normalY + normalZ * normalZ);
+    float normalX, normalY, normalZ;
+    calculateHeightmapNormal(terrain.get(x, z), terrain.get(x + 1, z), terrain.get(x, z + 1), 1.0f, normalX, normalY, normalZ);
 
-    return Point(normalX / length, normalY / length, normalZ / length);
+    return Point(normalX, normalY, normalZ);
 }
 
 class Polygon {
@@ -52,33 +93,10 @@ class Polygon {
             float dot = (normal.x * lightSource.x) + (normal.y * lightSource.y) + (normal.z * lightSource.z);
             float diffuse = std::max(0.2f, std::min(1.0f, dot));
 
-            // AI generated code for colors
-            float avgHeight = 0;
-            for(const auto& v : vertices) avgHeight += v.y;
-            avgHeight /= 4.0f;
-
-            // 2. Define our "Biome" colors
-            if (avgHeight <= 0.5f) {
-                // Water Bed
-                glColor3f(0.0f * diffuse, 0.0f * diffuse, 1.0f * diffuse); // Water Blue
-            } else if (avgHeight <= 6.0f) {
-                // Deep Valley
-                glColor3f(0.1f * diffuse, 0.4f * diffuse, 0.1f * diffuse); // Very Dark Green
-            } else if (avgHeight <= 24.0f) {
-                // Lush Lowlands
-                glColor3f(0.34f * diffuse, 0.7f * diffuse, 0.3f * diffuse); // Grass Green
-            } else if (avgHeight <= 30.0f) {
-                // High Peaks
-                glColor3f(0.45f * diffuse, 0.38f * diffuse, 0.26f * diffuse); // Mountain Rock Brown
-            } else {
-                // Snow Caps (only for the very highest points)
-                glColor3f(0.95f * diffuse, 0.95f * diffuse, 1.0f * diffuse); 
-            }
-
+            // every vertex was already given a biome, so this is just a table lookup
             glBegin(GL_QUADS);
             for (auto& vertex : vertices) {
-                Point* vPtr = &vertex;
-
+                biomeTable.setColor(biomeAt(vertex.x, vertex.z), diffuse);
                 glVertex3f(vertex.x, vertex.y, vertex.z);
             }
             glEnd();
@@ -98,93 +116,131 @@ class Polygon {
 };
 
 void generateTerrainGrid() {
-    for(int x = 0; x < gridWidth; x++) {
-        for(int y = 0; y < gridHeight; y++) {
-            xCoords[x][y] = x;
-            zCoords[x][y] = y;
+    generateTerrainGrid(terrain, 0, 0, 1, terrainSeed, defaultThreadCount());
+}
 
-            float offsetX = rand() % 1000;
-            float offsetY = rand() % 1000;
+// --bench-noise, how many cells per second the noise gets through
+// raw simplex (one octave), the full terrain recipe on one thread, and the full recipe on every core
+void benchmarkNoise() {
+    const int size = 1024;
+    auto secondsSince = [](std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    };
+    auto report = [](const char* name, double cells, double seconds) {
+        std::cout << "  " << name << ": " << cells / seconds / 1e6 << " million cells/s" << std::endl;
+    };
 
-            // generate some mountains
-            double mountains = (sin((x + offsetX) * 0.01) + cos((y + offsetY) * 0.015)) * 35.0f;
+    std::cout << "Noise benchmark (" << size << " x " << size << " cells):" << std::endl;
 
-            // generate some hills (less sin / cos than mountains so smaller (duh))
-            double hills = (sin(x * 0.06) + cos(y * 0.08)) * 8.0f;
+    std::vector<float> xs(size), zs(size), out(size);
+    auto start = std::chrono::steady_clock::now();
+    for (int x = 0; x < size; x++) {
+        for (int z = 0; z < size; z++) {
+            xs[z] = x * 0.05f;
+            zs[z] = z * 0.05f;
+        }
+        simplexNoiseRow(xs.data(), zs.data(), size, terrainSeed, out.data());
+    }
+    report("simplex, 1 octave", (double)size * size, secondsSince(start));
 
-            // add in some noise for some variation
-            float noise = noiseDistribution(generator);
+    Heightmap heights(size, size);
+    std::vector<int> threadCounts = { 1 };
+    if (defaultThreadCount() > 1) threadCounts.push_back(defaultThreadCount());
 
-            // then add it all together and add it to yCoords
-            float totalHeight = (float)(mountains + hills) + noise;
+    for (int threads : threadCounts) {
+        start = std::chrono::steady_clock::now();
+        generateTerrainGrid(heights, 0, 0, 1, terrainSeed, threads);
 
-            yCoords[x][y] = totalHeight;
-        }
+        std::string name = "terrain, " + std::to_string(threads) + " thread" + (threads == 1 ? "" : "s");
+        report(name.c_str(), (double)size * size, secondsSince(start));
     }
 }
 
-float summateTerrainGridNeighbors(int gridX, int gridZ, int radius = 1) {
-    int heightCount = 0;
-    float heights = 0;
-
-    for (int dx = -radius; dx <= radius; dx++) {
-        const int x = gridX + dx;
-        if(x < 0 || x >= gridWidth) {
-            continue;
-        }
+// --bench-heights, float against compact (16 bit) heights: memory (with the pyramid that goes with them), and how
+// fast generate / smooth / normals run on each
+void benchmarkHeightStorage() {
+    const int size = 2048;
+    const int passes = 3;
+    auto secondsSince = [](std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    };
 
-        for (int dz = -radius; dz <= radius; dz++) {
-            const int z = gridZ + dz;
-            if(z < 0 || z >= gridHeight) {
-                continue;
+    std::cout << "Height storage benchmark (" << size << " x " << size << " cells, " << passes << " smoothing passes):" << std::endl;
+
+    double smoothingRate[2] = { 0.0, 0.0 };
+    size_t bytes[2] = { 0, 0 }, pyramidBytes[2] = { 0, 0 };
+    HeightStorage storages[2] = { HEIGHTS_FLOAT, HEIGHTS_COMPACT };
+    for (int i = 0; i < 2; i++) {
+        Heightmap heights(size, size, storages[i]), smoothed(size, size, storages[i]);
+        double cells = (double)size * size;
+
+        auto start = std::chrono::steady_clock::now();
+        generateTerrainGrid(heights, 0, 0, 1, terrainSeed, defaultThreadCount());
+        double generateSeconds = secondsSince(start);
+
+        start = std::chrono::steady_clock::now();
+        smoothTerrainGridTiled(heights, smoothed, passes, smoothingTileSize, defaultThreadCount());
+        double smoothSeconds = secondsSince(start);
+
+        float sum = 0.0f;
+        start = std::chrono::steady_clock::now();
+        for (int x = 0; x < size; x++) {
+            for (int z = 0; z < size; z++) {
+                float normalX, normalY, normalZ;
+                calculateHeightmapNormalAt(smoothed, x, z, normalX, normalY, normalZ);
+                sum += normalY;
             }
-
-            // grid values are guarenteed to be safe now, so we can grab the value
-            heightCount++;
-            heights += yCoords[x][z];
         }
+        double normalSeconds = secondsSince(start);
+
+        HeightmapPyramid pyramid;
+        pyramid.build(smoothed);
+
+        bytes[i] = heights.sizeInBytes();
+        pyramidBytes[i] = pyramid.sizeInBytes();
+        smoothingRate[i] = cells * passes / smoothSeconds;
+        std::cout << "  " << (i == 0 ? "float:  " : "compact:") << " " << bytes[i] / (1024.0 * 1024.0) << " MB + "
+            << pyramidBytes[i] / (1024.0 * 1024.0) << " MB pyramid, generate "
+            << cells / generateSeconds / 1e6 << ", smooth " << smoothingRate[i] / 1e6 << ", normals "
+            << cells / normalSeconds / 1e6 << " million cells/s (" << sum / cells << ")" << std::endl;
     }
 
-    return heights / heightCount;
+    std::cout << "  compact saves " << (bytes[0] + pyramidBytes[0] - bytes[1] - pyramidBytes[1]) / (1024.0 * 1024.0)
+        << " MB per heightmap (pyramid included), smoothing runs at "
+        << smoothingRate[1] / smoothingRate[0] * 100.0 << "% of float speed" << std::endl;
 }
 
-void smoothTerrainGrid() {
-    for(int x = 0; x < gridWidth; x++) {
-        for(int z = 0; z < gridHeight; z++) {
-            // 3x3 approach
-            // grab neighbors, and summate their heights
-            // plus, we cap the bottom so we have a smooth surface down there
-            float neighborSummation = summateTerrainGridNeighbors(x, z);
-            if(neighborSummation < 7.5f) { 
-                neighborSummation = 0.0f;
-            }
-
-            smoothedYCoords[x][z] = neighborSummation;
-        }
-    };
+// smooths the whole grid passes times, in tiles with halos spread over every core
+// (gives exactly the same heights as doing it one pass at a time over the whole grid)
+void smoothTerrainGrid(int passes) {
+    smoothTerrainGridTiled(terrain, smoothedTerrain, passes, smoothingTileSize, defaultThreadCount());
 
     // set the actual values now after smoothing has completed
-    yCoords = smoothedYCoords;
+    // swap instead of copy, on big grids a copy is a whole extra pass over memory
+    terrain.swap(smoothedTerrain);
+}
+
+// the one time classification pass, has to run again whenever the heights or the table change
+void classifyTerrainBiomes() {
+    classifyBiomes(terrain, biomeTable, terrainBiomes);
 }
 
 std::vector<Polygon> generatePolygonsFromTerrainGrid() {
     std::vector<Polygon> polygons = {};
 
-    int coordsSize = xCoords.size();
-
     // must -1 here since 100 grid size -> 99 polygons
     // prevents an inaccessable grid error
-    for(int x = 0; x < coordsSize - 1; x++) {
-        for(int z = 0; z < coordsSize - 1; z++) {
+    for(int x = 0; x < terrain.width - 1; x++) {
+        for(int z = 0; z < terrain.depth - 1; z++) {
             Polygon polygon = Polygon();
 
             // we grab the points around it (4 in total for rectangle)
             // then we add that vertex to the polygon
             // we must go in a clockwise order so the points join together properly
-            polygon.addVertex({ xCoords[x][z], yCoords[x][z], zCoords[x][z] });
-            polygon.addVertex({ xCoords[x + 1][z], yCoords[x + 1][z], zCoords[x + 1][z] });
-            polygon.addVertex({ xCoords[x + 1][z + 1], yCoords[x + 1][z + 1], zCoords[x + 1][z + 1] });
-            polygon.addVertex({ xCoords[x][z + 1], yCoords[x][z + 1], zCoords[x][z + 1] });
+            polygon.addVertex({ (float)x, terrain.get(x, z), (float)z });
+            polygon.addVertex({ (float)(x + 1), terrain.get(x + 1, z), (float)z });
+            polygon.addVertex({ (float)(x + 1), terrain.get(x + 1, z + 1), (float)(z + 1) });
+            polygon.addVertex({ (float)x, terrain.get(x, z + 1), (float)(z + 1) });
 
             polygons.push_back(polygon);
         }
@@ -193,7 +249,173 @@ std::vector<Polygon> generatePolygonsFromTerrainGrid() {
     return polygons;
 }
 
-int main() {
+// prints the vertex cache miss ratio of every way we can draw the full resolution grid
+// the polygons send 4 vertices per quad no matter what (nothing is shared), everything else shares vertices
+void reportMeshCacheEfficiency() {
+    int quads = (gridWidth - 1) * (gridHeight - 1);
+    std::vector<uint32_t> polygonStream((size_t)quads * 4);
+    for (size_t i = 0; i < polygonStream.size(); i++) polygonStream[i] = i;
+
+    float light[3] = { 0.0f, 1.0f, 0.0f };
+    std::cout << "Vertex cache ACMR (32 entry fifo, lower is better):" << std::endl;
+    std::cout << "  polygons: " << computeACMR(polygonStream, quads * 2) << std::endl;
+
+    const char* names[] = { "rows", "strips", "forsyth" };
+    for (MeshOrder order : { MESH_ROWS, MESH_STRIPS, MESH_FORSYTH }) {
+        TerrainMesh candidate = buildTerrainMesh(terrain, terrainBiomes, biomeTable, 0, 0, gridWidth - 1, gridHeight - 1, order, light);
+        std::cout << "  " << names[order] << ": " << computeACMR(candidate.indices, candidate.triangleCount()) << std::endl;
+    }
+}
+
+int main(int argc, char** argv) {
+    // --grid <size> sets the grid size, --no-lod draws every quad at full resolution as one shared vertex mesh
+    // (--mesh rows|strips|forsyth picks the index order), --polygons draws it one Polygon at a time like before
+    // --report-acmr prints how well each way of drawing the full resolution grid uses the vertex cache once the
+    //   terrain is made (builds every mesh order over the whole grid, so it's slow and big on large grids)
+    // --stream switches to the infinite streaming world (arrow keys scroll), --tile-cache-mb caps its memory
+    // --cache <file> keeps the generated terrain in that file and loads it from there next time (off by default,
+    //   at big grid sizes the file is width * depth * 4 bytes)
+    // --biomes <file> loads the biome table (name maxHeight r g b per line), see biomes.txt
+    // --bench-noise prints how fast the noise generator is and exits
+    // --compact-heights keeps the heights in 16 bits instead of floats (half the memory, not with --erode)
+    // --bench-heights compares float and compact heights (memory and speed) and exits
+    // --erode runs hydraulic + thermal erosion on the terrain a bit every frame (not while streaming)
+    // --edit turns on the brush: left mouse raises, right mouse lowers, hold F for flatten (not while streaming)
+    // --headless runs generate / smooth / normals / biomes / mesh without a window and times each stage
+    //   (with --grid, --seed, --mesh, --passes <n>, --threads <n>, --no-mesh, --csv,
+    //    --out-heights <file.p3hm> and --out-mesh <file.obj>), then exits
+    // --export <file> writes the terrain out as binary .ply, .glb or .gltf (+ .bin) once it's made,
+    //   streamed from the heights so it works at any grid size (add --headless --no-mesh to skip the window)
+    // --render <file.bmp> raytraces a picture of the terrain on the cpu (--render-size <w>x<h>, --render-yaw <degrees>,
+    //   --no-shadows), also works with --headless
+    bool useLod = true;
+    bool usePolygons = false;
+    MeshOrder meshOrder = MESH_FORSYTH;
+    bool streaming = false;
+    size_t tileCacheMegabytes = 64;
+    std::string cachePath;
+    std::string biomePath;
+    bool benchNoise = false;
+    bool benchHeights = false;
+    bool reportAcmr = false;
+    bool compactHeights = false;
+    bool erode = false;
+    bool editing = false;
+    bool headless = false;
+    bool meshOrderSet = false;
+    HeadlessOptions headlessOptions;
+    headlessOptions.smoothingPasses = smoothingPasses;
+    headlessOptions.smoothingTileSize = smoothingTileSize;
+    headlessOptions.threadCount = defaultThreadCount();
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--grid" && i + 1 < argc) {
+            gridWidth = gridHeight = std::max(2, std::atoi(argv[++i]));
+        } else if (arg == "--no-lod") {
+            useLod = false;
+        } else if (arg == "--polygons") {
+            useLod = false;
+            usePolygons = true;
+        } else if (arg == "--mesh" && i + 1 < argc) {
+            std::string order = argv[++i];
+            meshOrder = (order == "rows") ? MESH_ROWS : (order == "strips") ? MESH_STRIPS : MESH_FORSYTH;
+            meshOrderSet = true;
+        } else if (arg == "--stream") {
+            streaming = true;
+        } else if (arg == "--tile-cache-mb" && i + 1 < argc) {
+            tileCacheMegabytes = std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "--cache" && i + 1 < argc) {
+            cachePath = argv[++i];
+        } else if (arg == "--biomes" && i + 1 < argc) {
+            biomePath = argv[++i];
+        } else if (arg == "--seed" && i + 1 < argc) {
+            const char* text = argv[++i];
+            char* end = nullptr;
+            errno = 0;
+            unsigned long value = std::strtoul(text, &end, 10);
+            if (end != text && *end == '\0' && text[0] != '-' && errno != ERANGE && value <= UINT32_MAX) {
+                terrainSeed = (uint32_t)value;
+            } else {
+                std::cout << "--seed wants a whole number from 0 to " << UINT32_MAX << ", ignoring it" << std::endl;
+            }
+        } else if (arg == "--erode") {
+            erode = true;
+        } else if (arg == "--edit") {
+            editing = true;
+        } else if (arg == "--headless") {
+            headless = true;
+        } else if (arg == "--passes" && i + 1 < argc) {
+            headlessOptions.smoothingPasses = std::max(0, std::atoi(argv[++i]));
+        } else if (arg == "--threads" && i + 1 < argc) {
+            headlessOptions.threadCount = std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "--no-mesh") {
+            headlessOptions.buildMesh = false;
+        } else if (arg == "--csv") {
+            headlessOptions.csv = true;
+        } else if (arg == "--out-heights" && i + 1 < argc) {
+            headlessOptions.heightsPath = argv[++i];
+        } else if (arg == "--out-mesh" && i + 1 < argc) {
+            headlessOptions.meshPath = argv[++i];
+        } else if (arg == "--export" && i + 1 < argc) {
+            headlessOptions.exportPath = argv[++i];
+        } else if (arg == "--render" && i + 1 < argc) {
+            headlessOptions.renderPath = argv[++i];
+        } else if (arg == "--render-size" && i + 1 < argc) {
+            int width = 0, height = 0;
+            if (std::sscanf(argv[++i], "%dx%d", &width, &height) == 2 && width > 0 && height > 0) {
+                headlessOptions.render.width = width;
+                headlessOptions.render.height = height;
+            }
+        } else if (arg == "--render-yaw" && i + 1 < argc) {
+            headlessOptions.render.yaw = (float)std::atof(argv[++i]);
+        } else if (arg == "--no-shadows") {
+            headlessOptions.render.shadows = false;
+        } else if (arg == "--bench-noise") {
+            benchNoise = true;
+        } else if (arg == "--bench-heights") {
+            benchHeights = true;
+        } else if (arg == "--report-acmr") {
+            reportAcmr = true;
+        } else if (arg == "--compact-heights") {
+            compactHeights = true;
+        }
+    }
+
+    if (benchNoise) {
+        benchmarkNoise();
+        return 0;
+    }
+
+    if (benchHeights) {
+        benchmarkHeightStorage();
+        return 0;
+    }
+
+    // erosion works on the raw float rows, and its tiny changes per slice would mostly round away in 16 bits
+    if (compactHeights && erode) {
+        std::cout << "--erode needs float heights, ignoring --compact-heights" << std::endl;
+        compactHeights = false;
+    }
+    headlessOptions.heightStorage = compactHeights ? HEIGHTS_COMPACT : HEIGHTS_FLOAT;
+
+    if (!biomePath.empty()) {
+        biomeTable.loadFromFile(biomePath);
+    }
+
+    Point lightSource = Point(0.5f, 1.0f, 0.5f); // light coming from above and slightly to the side
+    float lightDirection[3] = { lightSource.x, lightSource.y, lightSource.z };
+
+    if (headless) {
+        headlessOptions.width = gridWidth;
+        headlessOptions.depth = gridHeight;
+        headlessOptions.seed = terrainSeed;
+        if (meshOrderSet) headlessOptions.meshOrder = meshOrder;
+        headlessOptions.biomeTable = biomeTable;
+        std::copy(lightDirection, lightDirection + 3, headlessOptions.lightDirection);
+
+        return runHeadlessPipeline(headlessOptions);
+    }
+
     if (!glfwInit()) return -1;
 
     GLFWwindow* window = glfwCreateWindow(windowWidth, windowHeight, "Project3", NULL, NULL);
@@ -202,29 +424,144 @@ int main() {
         return -1;
     }
     
-    Point lightSource = Point(0.5f, 1.0f, 0.5f); // light coming from above and slightly to the side
-    float rotationX, rotationY, rotationZ = 0.0;
+    float rotationX = 0.0f, rotationY = 0.0f, rotationZ = 0.0f;
+
+    // the streaming world doesn't have a fixed grid, tiles get generated in the background as we move
+    // so we skip building the grid up front and leave a core free for the render thread
+    std::unique_ptr<TerrainTileCache> tileCache;
+    float cameraX = 0.0f, cameraZ = 0.0f;
+
+    TerrainQuadtree quadtree;
+    TerrainMesh mesh;
+    std::vector<Polygon> polygons;
+    std::unique_ptr<TerrainErosion> erosion;
+    std::unique_ptr<TerrainEditor> editor;
+    Brush brush;
+
+    if (streaming) {
+        int workerCount = std::max(1, (int)std::thread::hardware_concurrency() - 1);
+        tileCache.reset(new TerrainTileCache(streamTileSize, streamPreviewStep, smoothingPasses, terrainSeed, tileCacheMegabytes * 1024 * 1024, workerCount));
+    } else {
+        TerrainParams params;
+        params.width = gridWidth;
+        params.depth = gridHeight;
+        params.seed = terrainSeed;
+        params.smoothingPasses = smoothingPasses;
+
+        // try the cache first, it only gets used if it was made with the exact same params
+        double startTime = glfwGetTime();
+        if (!cachePath.empty() && loadHeightmapCache(cachePath, params, terrain)) {
+            std::cout << "Loaded terrain from " << cachePath << " in " << (glfwGetTime() - startTime) * 1000.0 << " ms" << std::endl;
+            if (compactHeights) terrain.setStorage(HEIGHTS_COMPACT);
+        } else {
+            // set the sizes of the grids on load
+            if (compactHeights) {
+                terrain.setStorage(HEIGHTS_COMPACT);
+                smoothedTerrain.setStorage(HEIGHTS_COMPACT);
+            }
+            terrain.resize(gridWidth, gridHeight);
+            smoothedTerrain.resize(gridWidth, gridHeight);
+
+            // generate terrain
+            generateTerrainGrid();
+
+            // smooth the terrain
+            // multiple passes to smooth a bunch
+            smoothTerrainGrid(smoothingPasses);
+
+            std::cout << "Generated terrain in " << (glfwGetTime() - startTime) * 1000.0 << " ms" << std::endl;
+
+            // (not from compact heights, float runs would load the rounded heights back)
+            if (!cachePath.empty() && !compactHeights && !saveHeightmapCache(cachePath, params, terrain)) {
+                std::cerr << "Couldn't write terrain cache " << cachePath << "\n";
+            }
+        }
+
+        classifyTerrainBiomes();
+
+        if (!headlessOptions.exportPath.empty()) {
+            startTime = glfwGetTime();
+            if (exportTerrain(headlessOptions.exportPath, terrain, biomeTable, lightDirection)) {
+                std::cout << "Exported terrain to " << headlessOptions.exportPath << " in " << (glfwGetTime() - startTime) * 1000.0 << " ms" << std::endl;
+            } else {
+                std::cerr << "Couldn't export " << headlessOptions.exportPath << "\n";
+            }
+        }
+
+        if (!headlessOptions.renderPath.empty()) {
+            startTime = glfwGetTime();
+            HeightmapPyramid pyramid;
+            pyramid.build(terrain);
+
+            std::vector<uint8_t> rgb;
+            raytraceTerrain(terrain, pyramid, biomeTable, lightDirection, headlessOptions.render, rgb);
+            if (writeImageBmp(headlessOptions.renderPath, headlessOptions.render.width, headlessOptions.render.height, rgb)) {
+                std::cout << "Rendered terrain to " << headlessOptions.renderPath << " in " << (glfwGetTime() - startTime) * 1000.0 << " ms" << std::endl;
+            } else {
+                std::cerr << "Couldn't write " << headlessOptions.renderPath << "\n";
+            }
+        }
 
-    // set the sizes of the vectors on load
-    xCoords.resize(gridWidth, std::vector<float>(gridHeight));
-    yCoords.resize(gridWidth, std::vector<float>(gridHeight));
-    zCoords.resize(gridWidth, std::vector<float>(gridHeight));
-    smoothedYCoords.resize(gridWidth, std::vector<float>(gridHeight));
+        // the quadtree is all the lod renderer needs, the polygons are only built for the full resolution path
+        // (at 16k x 16k there would be 268 million of them)
+        if (useLod) {
+            quadtree.build(terrain, terrainBiomes, biomeTable, terrainChunkSize);
+        } else if (usePolygons) {
+            polygons = generatePolygonsFromTerrainGrid();
+        } else {
+            mesh = buildTerrainMesh(terrain, terrainBiomes, biomeTable, 0, 0, gridWidth - 1, gridHeight - 1, meshOrder, lightDirection);
+        }
 
-    // generate terrain
-    generateTerrainGrid();
+        if (reportAcmr) {
+            reportMeshCacheEfficiency();
+        }
 
-    // smooth the terrain
-    // we call multiple times to smooth a bunch
-    smoothTerrainGrid();
-    smoothTerrainGrid();
-    smoothTerrainGrid();
+        // the editor needs the heights from before smoothing, the cache only has them after, so just make them again
+        if (editing) {
+            Heightmap raw(gridWidth, gridHeight);
+            generateTerrainGrid(raw, 0, 0, 1, terrainSeed, defaultThreadCount());
+            editor.reset(new TerrainEditor(terrain, std::move(raw), smoothingPasses));
+        }
 
-    // generate polygons from the grid
-    std::vector<Polygon> polygons = generatePolygonsFromTerrainGrid();
+        if (erode) {
+            ErosionSettings settings;
+            settings.seed = terrainSeed;
+            erosion.reset(new TerrainErosion(terrain, settings));
+        }
+    }
 
     glEnable(GL_DEPTH_TEST);
 
+    double lastTitleUpdate = 0.0;
+    bool biomeKeyWasDown = false;
+
+    // the heights in changed were edited or eroded, bring whatever draws the terrain up to date for just those
+    auto refreshTerrainRegion = [&](const HeightmapRegion& changed) {
+        if (changed.empty()) return;
+
+        // normals look one vertex ahead, so the vertices just before the region change too
+        HeightmapRegion shaded = changed.expanded(1, terrain.width, terrain.depth);
+        classifyBiomes(terrain, biomeTable, terrainBiomes, changed);
+
+        if (useLod) {
+            quadtree.refreshRegion(changed);
+        } else if (usePolygons) {
+            int cellsZ = terrain.depth - 1;
+            for (int x = shaded.x0; x < std::min(shaded.x1, terrain.width - 1); x++) {
+                for (int z = shaded.z0; z < std::min(shaded.z1, cellsZ); z++) {
+                    Polygon& polygon = polygons[(size_t)x * cellsZ + z];
+                    polygon.updateVertex(0, { (float)x, terrain.get(x, z), (float)z });
+                    polygon.updateVertex(1, { (float)(x + 1), terrain.get(x + 1, z), (float)z });
+                    polygon.updateVertex(2, { (float)(x + 1), terrain.get(x + 1, z + 1), (float)(z + 1) });
+                    polygon.updateVertex(3, { (float)x, terrain.get(x, z + 1), (float)(z + 1) });
+                }
+            }
+        } else {
+            mesh.updateHeights(terrain, shaded, lightDirection);
+            mesh.colorize(terrainBiomes, terrain.depth, biomeTable, shaded);
+        }
+    };
+
     glfwMakeContextCurrent(window);
     while (!glfwWindowShouldClose(window)) {
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -238,9 +575,13 @@ int main() {
 
         // calculate window size based on grid
         // this centers the terrain within the viewport
+        // (when streaming we show a bit less than what's loaded so the edges fill in before they're on screen)
         float margin = 1.2f;
         float halfW = (gridWidth / 2.0f) * margin;
         float halfH = (gridHeight / 2.0f) * margin;
+        if (streaming) {
+            halfW = halfH = streamTileSize * (streamRadius - 1);
+        }
 
         glOrtho(-halfW, halfW, -halfH, halfH, -1000, 1000);
 
@@ -253,13 +594,34 @@ int main() {
 
         // listen for XYZ input to rotate the grid
         if (glfwGetKey(window, GLFW_KEY_X) == GLFW_PRESS) {
-            rotationX += gridHeight / 100;
+            rotationX += rotationSpeed;
         }
         if (glfwGetKey(window, GLFW_KEY_Y) == GLFW_PRESS) {
-            rotationY += gridHeight / 100;
+            rotationY += rotationSpeed;
         }
         if (glfwGetKey(window, GLFW_KEY_Z) == GLFW_PRESS) {
-            rotationZ += gridHeight / 100;
+            rotationZ += rotationSpeed;
+        }
+
+        // B reloads the biome file and reclassifies, only the colors change so nothing gets rebuilt
+        // (the streamed tiles notice the new table version and reclassify themselves when drawn)
+        bool biomeKeyDown = glfwGetKey(window, GLFW_KEY_B) == GLFW_PRESS;
+        if (biomeKeyDown && !biomeKeyWasDown && !biomePath.empty() && biomeTable.loadFromFile(biomePath)) {
+            if (!streaming) {
+                classifyTerrainBiomes();
+                if (!useLod && !usePolygons) mesh.colorize(terrainBiomes, terrain.depth, biomeTable);
+            }
+            std::cout << "Reloaded " << biomeTable.biomes.size() << " biomes from " << biomePath << std::endl;
+        }
+        biomeKeyWasDown = biomeKeyDown;
+
+        // erode for a bit, then bring whatever draws the terrain up to date with the heights it changed
+        if (erosion && !erosion->finished()) {
+            refreshTerrainRegion(erosion->run(erosionBudget));
+
+            if (erosion->finished()) {
+                std::cout << "Erosion finished after " << erosion->totalSlices() << " slices" << std::endl;
+            }
         }
 
         // rotate using rotation variables
@@ -267,10 +629,62 @@ int main() {
         glRotatef(rotationY, 0, 1, 0);
         glRotatef(rotationZ, 0, 0, 1);
 
-        glTranslatef((-gridWidth / 2), 0, (-gridHeight / 2));
+        if (streaming) {
+            // arrow keys scroll the world
+            if (glfwGetKey(window, GLFW_KEY_LEFT) == GLFW_PRESS) cameraX -= cameraSpeed;
+            if (glfwGetKey(window, GLFW_KEY_RIGHT) == GLFW_PRESS) cameraX += cameraSpeed;
+            if (glfwGetKey(window, GLFW_KEY_UP) == GLFW_PRESS) cameraZ -= cameraSpeed;
+            if (glfwGetKey(window, GLFW_KEY_DOWN) == GLFW_PRESS) cameraZ += cameraSpeed;
+
+            glTranslatef(-cameraX, 0, -cameraZ);
+
+            tileCache->update(cameraX, cameraZ, streamRadius);
+            tileCache->draw(Frustum::fromCurrentMatrices(), biomeTable, lightDirection);
+
+            double now = glfwGetTime();
+            if (now - lastTitleUpdate > 0.5) {
+                std::string title = "Project3 - " + std::to_string(tileCache->readyTiles) + " tiles ready, "
+                    + std::to_string(tileCache->previewTiles) + " preview, " + std::to_string(tileCache->pendingTiles) + " pending, "
+                    + std::to_string(tileCache->getMemoryUsed() / (1024 * 1024)) + " MB cached";
+                glfwSetWindowTitle(window, title.c_str());
+                lastTitleUpdate = now;
+            }
+        } else {
+            glTranslatef((-gridWidth / 2), 0, (-gridHeight / 2));
+
+            // brush under the cursor, everything after the edit only gets redone for the region it changed
+            bool raise = glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS;
+            bool lower = glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_RIGHT) == GLFW_PRESS;
+            double cursorX, cursorY;
+            float hitX, hitZ;
+            glfwGetCursorPos(window, &cursorX, &cursorY);
+
+            if (editor && (raise || lower) && pickTerrain(terrain, cursorX, cursorY, hitX, hitZ)) {
+                brush.mode = (glfwGetKey(window, GLFW_KEY_F) == GLFW_PRESS) ? BRUSH_FLATTEN : raise ? BRUSH_RAISE : BRUSH_LOWER;
+                refreshTerrainRegion(editor->edit(hitX, hitZ, brush));
+            }
 
-        for (auto& polygon : polygons) {
-            polygon.draw(lightSource);
+            if (useLod) {
+                quadtree.draw(makeLodView(maxScreenError, minCellPixels), lightDirection);
+
+                // show how much we're actually drawing, a couple times a second is plenty
+                double now = glfwGetTime();
+                if (now - lastTitleUpdate > 0.5) {
+                    std::string title = "Project3 - " + std::to_string(quadtree.visibleChunks) + " chunks visible, "
+                        + std::to_string(quadtree.culledChunks) + " chunks culled, " + std::to_string(quadtree.drawnTriangles) + " triangles";
+                    if (erosion && !erosion->finished()) {
+                        title += ", eroding " + std::to_string(erosion->completedSlices() * 100 / erosion->totalSlices()) + "%";
+                    }
+                    glfwSetWindowTitle(window, title.c_str());
+                    lastTitleUpdate = now;
+                }
+            } else if (usePolygons) {
+                for (auto& polygon : polygons) {
+                    polygon.draw(lightSource);
+                }
+            } else {
+                mesh.draw();
+            }
         }
 
         glfwSwapBuffers(window);
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstdio>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <GLFW/glfw3.h>
+
+#include "terrain_mesh.h"
+
+// writing terrain meshes out so other tools (blender, meshlab...) can open them
+
+// the mesh as triangles no matter how it's drawn, strips get unrolled and their degenerate triangles dropped
+// (every other strip triangle is flipped back so they all keep the same winding)
+template <typename Emit>
+void forEachMeshTriangle(const TerrainMesh& mesh, const Emit& emit) {
+    const std::vector<uint32_t>& indices = mesh.indices;
+
+    if (mesh.primitive == GL_TRIANGLES) {
+        for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+            emit(indices[i], indices[i + 1], indices[i + 2]);
+        }
+        return;
+    }
+
+    for (size_t i = 2; i < indices.size(); i++) {
+        uint32_t a = indices[i - 2], b = indices[i - 1], c = indices[i];
+        if (a == b || b == c || a == c) continue;
+
+        if (i % 2 == 0) {
+            emit(a, b, c);
+        } else {
+            emit(b, a, c);
+        }
+    }
+}
+
+// wavefront obj, positions + triangles
+inline bool writeMeshObj(const std::string& path, const TerrainMesh& mesh) {
+    FILE* file = std::fopen(path.c_str(), "w");
+    if (!file) return false;
+
+    // big buffer, there are a lot of tiny writes
+    std::vector<char> buffer(1 << 20);
+    std::setvbuf(file, buffer.data(), _IOFBF, buffer.size());
+
+    bool ok = std::fprintf(file, "# project3 terrain\n") > 0;
+    for (size_t i = 0; ok && i + 2 < mesh.positions.size(); i += 3) {
+        ok = std::fprintf(file, "v %g %g %g\n", mesh.positions[i], mesh.positions[i + 1], mesh.positions[i + 2]) > 0;
+    }
+
+    forEachMeshTriangle(mesh, [&](uint32_t a, uint32_t b, uint32_t c) {
+        if (ok) ok = std::fprintf(file, "f %u %u %u\n", a + 1, b + 1, c + 1) > 0;
+    });
+
+    ok = (std::fclose(file) == 0) && ok;
+    return ok;
+}
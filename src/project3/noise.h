@@ -0,0 +1,171 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+
+// seeded 2d simplex noise + fBm
+//
+// everything works on a whole row of sample points at once (two arrays of coordinates in, one array out)
+// the inner loops have no table lookups and no comparisons (those count as possibly trapping, which stops gcc
+// from vectorizing unless you pass -fno-trapping-math), so the compiler can turn them into simd instructions
+// every output only depends on its own coordinates + the seed, which means any sub-rectangle evaluated on its
+// own gives exactly the same numbers as the whole grid would
+
+// integer hash of a lattice point, used instead of a permutation table so we don't need a gather per corner
+// also what everything else uses when it needs the same "random" number for a grid position no matter which
+// tile, thread or order it gets made in (rand() can't do that)
+inline uint32_t hashLattice(int32_t x, int32_t z, uint32_t seed) {
+    uint32_t h = seed * 0x9E3779B9u;
+    h ^= (uint32_t)x * 0x85EBCA6Bu;
+    h ^= (uint32_t)z * 0xC2B2AE35u;
+
+    h ^= h >> 16;
+    h *= 0x7FEB352Du;
+    h ^= h >> 15;
+    h *= 0x846CA68Bu;
+    h ^= h >> 16;
+
+    return h;
+}
+
+// 1 if v is negative, 0 otherwise, straight from the sign bit
+inline int32_t signBit(float v) {
+    uint32_t bits;
+    std::memcpy(&bits, &v, sizeof(bits));
+    return (int32_t)(bits >> 31);
+}
+
+// floor without a comparison, truncating rounds negative numbers up so we take one off when it did
+inline int32_t floorToInt(float v) {
+    int32_t truncated = (int32_t)v;
+    return truncated - signBit(v - (float)truncated);
+}
+
+// dot product of one of 8 gradients (picked by the hash) with (x, z)
+// written with arithmetic instead of ?: so the row loop doesn't end up with branches in it
+inline float simplexGradient(uint32_t h, float x, float z) {
+    float swap = (float)((h >> 2) & 1);
+    float u = x + (z - x) * swap;
+    float v = z + (x - z) * swap;
+    float signU = 1.0f - 2.0f * (float)(h & 1);
+    float signV = 2.0f - 4.0f * (float)((h >> 1) & 1);
+    return u * signU + v * signV;
+}
+
+// corner contribution, (0.5 - r^2)^4 * gradient, or 0 if the point is outside the corner's radius
+inline float simplexCorner(uint32_t h, float x, float z) {
+    float t = 0.5f - x * x - z * z;
+    t = 0.5f * (t + std::fabs(t)); // max(t, 0)
+    t *= t;
+    return t * t * simplexGradient(h, x, z);
+}
+
+// roughly -1 to 1
+inline void simplexNoiseRow(const float* xs, const float* zs, int count, uint32_t seed, float* out) {
+    const float F2 = 0.36602540378f; // (sqrt(3) - 1) / 2
+    const float G2 = 0.21132486540f; // (3 - sqrt(3)) / 6
+
+    for (int n = 0; n < count; n++) {
+        float x = xs[n], z = zs[n];
+
+        // skew into the simplex grid and find the cell we're in
+        float s = (x + z) * F2;
+        float fx = x + s, fz = z + s;
+        int32_t i = floorToInt(fx);
+        int32_t j = floorToInt(fz);
+
+        float t = (float)(i + j) * G2;
+        float x0 = x - ((float)i - t);
+        float z0 = z - ((float)j - t);
+
+        // which of the cell's two triangles we're in
+        int32_t i1 = signBit(z0 - x0); // x0 > z0
+        int32_t j1 = 1 - i1;
+
+        float x1 = x0 - (float)i1 + G2, z1 = z0 - (float)j1 + G2;
+        float x2 = x0 - 1.0f + 2.0f * G2, z2 = z0 - 1.0f + 2.0f * G2;
+
+        float sum = simplexCorner(hashLattice(i, j, seed), x0, z0)
+                  + simplexCorner(hashLattice(i + i1, j + j1, seed), x1, z1)
+                  + simplexCorner(hashLattice(i + 1, j + 1, seed), x2, z2);
+
+        // scales the biggest possible sum to about 1
+        out[n] = sum * 45.23f;
+    }
+}
+
+// one fBm layer, frequencies are in cycles per grid cell
+struct NoiseLayer {
+    int octaves = 5;
+    float frequency = 1.0f / 256.0f;
+    float lacunarity = 2.0f; // frequency multiplier per octave
+    float gain = 0.5f;       // amplitude multiplier per octave
+    bool ridged = false;     // ridged multifractal (sharp crests) instead of plain fBm
+    uint32_t seed = 0;
+};
+
+// sums octaves of simplex noise over a row of points
+// plain fBm comes out around -1 to 1, ridged comes out 0 to 1
+inline void fbmNoiseRow(const NoiseLayer& layer, const float* xs, const float* zs, int count, float* out) {
+    std::vector<float> octaveXs(count), octaveZs(count), noise(count), weight(count, 1.0f);
+    std::fill(out, out + count, 0.0f);
+
+    float frequency = layer.frequency;
+    float amplitude = 1.0f;
+    float totalAmplitude = 0.0f;
+
+    for (int octave = 0; octave < layer.octaves; octave++) {
+        for (int n = 0; n < count; n++) {
+            octaveXs[n] = xs[n] * frequency;
+            octaveZs[n] = zs[n] * frequency;
+        }
+
+        // every octave gets its own seed so they don't line up at the origin
+        simplexNoiseRow(octaveXs.data(), octaveZs.data(), count, layer.seed + octave * 0x632BE5ABu, noise.data());
+
+        if (layer.ridged) {
+            // fold the noise so its zero crossings turn into crests, each octave is weighted by the one
+            // before it so the detail piles up on the ridges and the valleys stay smooth
+            for (int n = 0; n < count; n++) {
+                float ridge = 1.0f - std::fabs(noise[n]);
+                ridge *= ridge * weight[n];
+                float next = ridge * 2.0f;
+                weight[n] = 0.5f * (1.0f + next - std::fabs(1.0f - next)); // min(next, 1)
+                out[n] += ridge * amplitude;
+            }
+        } else {
+            for (int n = 0; n < count; n++) {
+                out[n] += noise[n] * amplitude;
+            }
+        }
+
+        totalAmplitude += amplitude;
+        frequency *= layer.lacunarity;
+        amplitude *= layer.gain;
+    }
+
+    float scale = 1.0f / totalAmplitude;
+    for (int n = 0; n < count; n++) {
+        out[n] *= scale;
+    }
+}
+
+// domain warping, pushes every point around by a low frequency noise field (strength is in grid cells)
+// so the features bend and stop looking like they're sitting on a lattice
+inline void warpNoiseRow(const NoiseLayer& layer, float strength, float* xs, float* zs, int count) {
+    std::vector<float> offsetX(count), offsetZ(count);
+
+    NoiseLayer other = layer;
+    other.seed = layer.seed ^ 0x5BD1E995u;
+
+    fbmNoiseRow(layer, xs, zs, count, offsetX.data());
+    fbmNoiseRow(other, xs, zs, count, offsetZ.data());
+
+    for (int n = 0; n < count; n++) {
+        xs[n] += offsetX[n] * strength;
+        zs[n] += offsetZ[n] * strength;
+    }
+}
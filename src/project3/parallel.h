@@ -0,0 +1,40 @@
+#pragma once
+
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <algorithm>
+
+// how many threads to use when nobody asked for a specific number
+inline int defaultThreadCount() {
+    return std::max(1, (int)std::thread::hardware_concurrency());
+}
+
+// runs work(i) for every i in [0, count) spread over threadCount threads
+// items are handed out one at a time, so uneven items still balance out
+// work has to be safe to run for different items at the same time
+template <typename Work>
+void parallelFor(int count, int threadCount, const Work& work) {
+    threadCount = std::max(1, std::min(threadCount, count));
+    if (threadCount == 1) {
+        for (int i = 0; i < count; i++) work(i);
+        return;
+    }
+
+    std::atomic<int> next(0);
+    auto worker = [&]() {
+        for (int i = next++; i < count; i = next++) {
+            work(i);
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (int t = 1; t < threadCount; t++) {
+        threads.emplace_back(worker);
+    }
+    worker();
+
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
@@ -0,0 +1,183 @@
+#pragma once
+
+#include <GLFW/glfw3.h>
+
+#include <cmath>
+#include <algorithm>
+
+#include "heightmap.h"
+#include "terrain_generator.h"
+
+// interactive terrain editing
+//
+// the brush works on the raw (unsmoothed) heights and then only the part of the terrain the smoothing can
+// see from there gets smoothed again: the brush area plus smoothingHalo(passes) on every side. everything
+// that hangs off the heights (biomes, normals, lod bounds, vertex buffers) only has to be redone for the
+// region that comes back, so an edit costs about the same on a 250 x 250 map as on a 16k x 16k one
+
+enum BrushMode {
+    BRUSH_RAISE,
+    BRUSH_LOWER,
+    BRUSH_FLATTEN // pulls everything under the brush towards the height at its center
+};
+
+struct Brush {
+    BrushMode mode = BRUSH_RAISE;
+    float radius = 10.0f;  // in grid cells
+    float strength = 0.5f; // height change per application at the center (fraction of the way for flatten)
+};
+
+// changes the raw heights under the brush, returns the region of raw heights it touched
+inline HeightmapRegion applyBrush(Heightmap& raw, float centerX, float centerZ, const Brush& brush) {
+    HeightmapRegion region;
+    region.x0 = (int)std::floor(centerX - brush.radius);
+    region.z0 = (int)std::floor(centerZ - brush.radius);
+    region.x1 = (int)std::ceil(centerX + brush.radius) + 1;
+    region.z1 = (int)std::ceil(centerZ + brush.radius) + 1;
+    region = region.expanded(0, raw.width, raw.depth);
+    if (region.empty()) return region;
+
+    int centerCellX = std::min(std::max((int)std::lround(centerX), 0), raw.width - 1);
+    int centerCellZ = std::min(std::max((int)std::lround(centerZ), 0), raw.depth - 1);
+    float target = raw.get(centerCellX, centerCellZ);
+
+    for (int x = region.x0; x < region.x1; x++) {
+        for (int z = region.z0; z < region.z1; z++) {
+            float dx = x - centerX, dz = z - centerZ;
+            float distance = std::sqrt(dx * dx + dz * dz) / brush.radius;
+            if (distance >= 1.0f) continue;
+
+            // smooth falloff so the brush doesn't leave a step at its edge
+            float falloff = 0.5f + 0.5f * std::cos(distance * 3.14159265f);
+            float height = raw.get(x, z);
+
+            switch (brush.mode) {
+                case BRUSH_RAISE:
+                    height += brush.strength * falloff;
+                    break;
+                case BRUSH_LOWER:
+                    height -= brush.strength * falloff;
+                    break;
+                case BRUSH_FLATTEN:
+                    height += (target - height) * std::min(1.0f, brush.strength * falloff);
+                    break;
+            }
+
+            raw.set(x, z, height);
+        }
+    }
+
+    return region;
+}
+
+// keeps the raw heights next to the smoothed terrain so edits can be smoothed the same way generation was
+// (anything done to the terrain after smoothing, like erosion, gets replaced inside the edited region)
+class TerrainEditor {
+    private:
+        Heightmap raw;
+        Heightmap& terrain;
+        int passes;
+
+    public:
+        TerrainEditor(Heightmap& smoothed, Heightmap rawHeights, int smoothingPasses)
+            : raw(std::move(rawHeights)), terrain(smoothed), passes(smoothingPasses) {}
+
+        // returns the region of the terrain that changed
+        HeightmapRegion edit(float centerX, float centerZ, const Brush& brush) {
+            HeightmapRegion touched = applyBrush(raw, centerX, centerZ, brush);
+            if (touched.empty()) return touched;
+
+            HeightmapRegion changed = touched.expanded(smoothingHalo(passes), terrain.width, terrain.depth);
+            smoothTerrainRegion(raw, terrain, changed, passes);
+
+            return changed;
+        }
+};
+
+// inverse of a column major 4x4 matrix, false if it can't be inverted
+inline bool invertMatrix4(const float m[16], float out[16]) {
+    float inv[16];
+    inv[0] = m[5] * m[10] * m[15] - m[5] * m[11] * m[14] - m[9] * m[6] * m[15] + m[9] * m[7] * m[14] + m[13] * m[6] * m[11] - m[13] * m[7] * m[10];
+    inv[4] = -m[4] * m[10] * m[15] + m[4] * m[11] * m[14] + m[8] * m[6] * m[15] - m[8] * m[7] * m[14] - m[12] * m[6] * m[11] + m[12] * m[7] * m[10];
+    inv[8] = m[4] * m[9] * m[15] - m[4] * m[11] * m[13] - m[8] * m[5] * m[15] + m[8] * m[7] * m[13] + m[12] * m[5] * m[11] - m[12] * m[7] * m[9];
+    inv[12] = -m[4] * m[9] * m[14] + m[4] * m[10] * m[13] + m[8] * m[5] * m[14] - m[8] * m[6] * m[13] - m[12] * m[5] * m[10] + m[12] * m[6] * m[9];
+    inv[1] = -m[1] * m[10] * m[15] + m[1] * m[11] * m[14] + m[9] * m[2] * m[15] - m[9] * m[3] * m[14] - m[13] * m[2] * m[11] + m[13] * m[3] * m[10];
+    inv[5] = m[0] * m[10] * m[15] - m[0] * m[11] * m[14] - m[8] * m[2] * m[15] + m[8] * m[3] * m[14] + m[12] * m[2] * m[11] - m[12] * m[3] * m[10];
+    inv[9] = -m[0] * m[9] * m[15] + m[0] * m[11] * m[13] + m[8] * m[1] * m[15] - m[8] * m[3] * m[13] - m[12] * m[1] * m[11] + m[12] * m[3] * m[9];
+    inv[13] = m[0] * m[9] * m[14] - m[0] * m[10] * m[13] - m[8] * m[1] * m[14] + m[8] * m[2] * m[13] + m[12] * m[1] * m[10] - m[12] * m[2] * m[9];
+    inv[2] = m[1] * m[6] * m[15] - m[1] * m[7] * m[14] - m[5] * m[2] * m[15] + m[5] * m[3] * m[14] + m[13] * m[2] * m[7] - m[13] * m[3] * m[6];
+    inv[6] = -m[0] * m[6] * m[15] + m[0] * m[7] * m[14] + m[4] * m[2] * m[15] - m[4] * m[3] * m[14] - m[12] * m[2] * m[7] + m[12] * m[3] * m[6];
+    inv[10] = m[0] * m[5] * m[15] - m[0] * m[7] * m[13] - m[4] * m[1] * m[15] + m[4] * m[3] * m[13] + m[12] * m[1] * m[7] - m[12] * m[3] * m[5];
+    inv[14] = -m[0] * m[5] * m[14] + m[0] * m[6] * m[13] + m[4] * m[1] * m[14] - m[4] * m[2] * m[13] - m[12] * m[1] * m[6] + m[12] * m[2] * m[5];
+    inv[3] = -m[1] * m[6] * m[11] + m[1] * m[7] * m[10] + m[5] * m[2] * m[11] - m[5] * m[3] * m[10] - m[9] * m[2] * m[7] + m[9] * m[3] * m[6];
+    inv[7] = m[0] * m[6] * m[11] - m[0] * m[7] * m[10] - m[4] * m[2] * m[11] + m[4] * m[3] * m[10] + m[8] * m[2] * m[7] - m[8] * m[3] * m[6];
+    inv[11] = -m[0] * m[5] * m[11] + m[0] * m[7] * m[9] + m[4] * m[1] * m[11] - m[4] * m[3] * m[9] - m[8] * m[1] * m[7] + m[8] * m[3] * m[5];
+    inv[15] = m[0] * m[5] * m[10] - m[0] * m[6] * m[9] - m[4] * m[1] * m[10] + m[4] * m[2] * m[9] + m[8] * m[1] * m[6] - m[8] * m[2] * m[5];
+
+    float determinant = m[0] * inv[0] + m[1] * inv[4] + m[2] * inv[8] + m[3] * inv[12];
+    if (std::fabs(determinant) < 1e-12f) return false;
+
+    for (int i = 0; i < 16; i++) out[i] = inv[i] / determinant;
+    return true;
+}
+
+// finds the terrain point under a window position (pixels, y down like glfwGetCursorPos)
+// call it with the terrain's transforms current, the hit comes back in grid coordinates
+inline bool pickTerrain(const Heightmap& heights, double windowX, double windowY, float& hitX, float& hitZ) {
+    float projection[16], modelview[16], clip[16], inverse[16];
+    int viewport[4];
+    glGetFloatv(GL_PROJECTION_MATRIX, projection);
+    glGetFloatv(GL_MODELVIEW_MATRIX, modelview);
+    glGetIntegerv(GL_VIEWPORT, viewport);
+
+    for (int column = 0; column < 4; column++) {
+        for (int row = 0; row < 4; row++) {
+            float sum = 0.0f;
+            for (int k = 0; k < 4; k++) sum += projection[k * 4 + row] * modelview[column * 4 + k];
+            clip[column * 4 + row] = sum;
+        }
+    }
+    if (!invertMatrix4(clip, inverse)) return false;
+
+    // the cursor on the near and far planes, back in terrain space
+    float ndcX = (float)((windowX - viewport[0]) / viewport[2] * 2.0 - 1.0);
+    float ndcY = (float)(1.0 - (windowY - viewport[1]) / viewport[3] * 2.0);
+    float ends[2][3];
+    for (int i = 0; i < 2; i++) {
+        float ndc[4] = { ndcX, ndcY, i == 0 ? -1.0f : 1.0f, 1.0f };
+        float world[4];
+        for (int row = 0; row < 4; row++) {
+            world[row] = 0.0f;
+            for (int k = 0; k < 4; k++) world[row] += inverse[k * 4 + row] * ndc[k];
+        }
+        for (int k = 0; k < 3; k++) ends[i][k] = world[k] / world[3];
+    }
+
+    // march along the ray in half cell steps until it goes under the terrain, then bisect the last step
+    float dx = ends[1][0] - ends[0][0], dy = ends[1][1] - ends[0][1], dz = ends[1][2] - ends[0][2];
+    float length = std::sqrt(dx * dx + dy * dy + dz * dz);
+    if (length <= 0.0f) return false;
+
+    auto below = [&](float t) {
+        float x = ends[0][0] + dx * t, z = ends[0][2] + dz * t;
+        if (x < 0 || z < 0 || x > heights.width - 1 || z > heights.depth - 1) return false;
+        return ends[0][1] + dy * t <= heights.get((int)std::lround(x), (int)std::lround(z));
+    };
+
+    float step = 0.5f / length;
+    for (float t = 0.0f; t <= 1.0f; t += step) {
+        if (!below(t)) continue;
+
+        float low = std::max(0.0f, t - step), high = t;
+        for (int i = 0; i < 16; i++) {
+            float middle = (low + high) * 0.5f;
+            if (below(middle)) high = middle; else low = middle;
+        }
+
+        hitX = ends[0][0] + dx * high;
+        hitZ = ends[0][2] + dz * high;
+        return true;
+    }
+
+    return false;
+}
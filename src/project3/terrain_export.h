@@ -0,0 +1,297 @@
+#pragma once
+
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include "heightmap.h"
+#include "biome.h"
+
+// terrain export straight from the heightmap: binary PLY and glTF 2.0 (.glb, or .gltf + .bin)
+//
+// nothing mesh sized is ever built, vertices and triangles are generated a row at a time and pushed through
+// one fixed size buffer, so the memory use is the heightmap plus exportBufferSize no matter how big the grid is
+//
+// every grid vertex becomes one vertex (position, normal, biome color with the lighting baked in) in [x][z]
+// order, every cell becomes two triangles. the winding is flipped compared to the GL_QUADS order we draw
+// with so the triangles face up (counter clockwise from above) like other tools expect
+
+const size_t exportBufferSize = 4 * 1024 * 1024;
+
+// buffered writes to a FILE, remembers if anything failed so the callers only check once at the end
+class ExportWriter {
+    private:
+        FILE* file = nullptr;
+        std::vector<uint8_t> buffer;
+        size_t used = 0;
+        bool failed = false;
+
+    public:
+        ExportWriter(const std::string& path) : buffer(exportBufferSize) {
+            file = std::fopen(path.c_str(), "wb");
+            failed = (file == nullptr);
+        }
+
+        ~ExportWriter() {
+            close();
+        }
+
+        void write(const void* data, size_t size) {
+            const uint8_t* bytes = (const uint8_t*)data;
+            while (size > 0 && !failed) {
+                if (used == buffer.size()) flush();
+
+                size_t amount = std::min(size, buffer.size() - used);
+                std::memcpy(buffer.data() + used, bytes, amount);
+                used += amount;
+                bytes += amount;
+                size -= amount;
+            }
+        }
+
+        void write(const std::string& text) {
+            write(text.data(), text.size());
+        }
+
+        template <typename T>
+        void writeValue(T value) {
+            write(&value, sizeof(value));
+        }
+
+        void pad(size_t count, uint8_t value) {
+            for (size_t i = 0; i < count; i++) write(&value, 1);
+        }
+
+        void flush() {
+            if (!failed && used > 0 && std::fwrite(buffer.data(), 1, used, file) != used) {
+                failed = true;
+            }
+            used = 0;
+        }
+
+        // true if everything made it to disk
+        bool close() {
+            if (file) {
+                flush();
+                if (std::fclose(file) != 0) failed = true;
+                file = nullptr;
+            }
+            return !failed;
+        }
+};
+
+inline bool exportHostIsLittleEndian() {
+    uint16_t value = 1;
+    uint8_t first;
+    std::memcpy(&first, &value, 1);
+    return first == 1;
+}
+
+// normal + lit biome color of one vertex, shared by both formats
+inline void exportVertexShading(const Heightmap& heights, const BiomeTable& table, const float lightSource[3],
+                                int x, int z, float normal[3], uint8_t color[3]) {
+    calculateHeightmapNormalAt(heights, x, z, normal[0], normal[1], normal[2]);
+
+    float dot = normal[0] * lightSource[0] + normal[1] * lightSource[1] + normal[2] * lightSource[2];
+    float diffuse = std::max(0.2f, std::min(1.0f, dot));
+
+    const float* biomeColor = table.color(table.classify(heights.get(x, z)));
+    for (int k = 0; k < 3; k++) {
+        color[k] = (uint8_t)std::lround(std::min(1.0f, biomeColor[k] * diffuse) * 255.0f);
+    }
+}
+
+// calls emit(a, b, c) for every triangle, in row order
+template <typename Emit>
+void forEachTerrainTriangle(const Heightmap& heights, const Emit& emit) {
+    for (int x = 0; x + 1 < heights.width; x++) {
+        for (int z = 0; z + 1 < heights.depth; z++) {
+            uint32_t v00 = (uint32_t)x * heights.depth + z;
+            uint32_t v10 = v00 + heights.depth;
+            uint32_t v11 = v10 + 1;
+            uint32_t v01 = v00 + 1;
+
+            emit(v00, v11, v10);
+            emit(v00, v01, v11);
+        }
+    }
+}
+
+inline uint64_t terrainExportVertexCount(const Heightmap& heights) {
+    return (uint64_t)heights.width * heights.depth;
+}
+
+inline uint64_t terrainExportTriangleCount(const Heightmap& heights) {
+    return (uint64_t)std::max(0, heights.width - 1) * std::max(0, heights.depth - 1) * 2;
+}
+
+// binary PLY, one interleaved vertex element (xyz, normal, rgb) and one face element of index triples
+inline bool exportTerrainPly(const std::string& path, const Heightmap& heights, const BiomeTable& table, const float lightSource[3]) {
+    if (terrainExportVertexCount(heights) > UINT32_MAX) return false;
+
+    ExportWriter writer(path);
+
+    std::string header = std::string("ply\n")
+        + "format " + (exportHostIsLittleEndian() ? "binary_little_endian" : "binary_big_endian") + " 1.0\n"
+        + "comment project3 terrain\n"
+        + "element vertex " + std::to_string(terrainExportVertexCount(heights)) + "\n"
+        + "property float x\nproperty float y\nproperty float z\n"
+        + "property float nx\nproperty float ny\nproperty float nz\n"
+        + "property uchar red\nproperty uchar green\nproperty uchar blue\n"
+        + "element face " + std::to_string(terrainExportTriangleCount(heights)) + "\n"
+        + "property list uchar uint vertex_indices\n"
+        + "end_header\n";
+    writer.write(header);
+
+    for (int x = 0; x < heights.width; x++) {
+        for (int z = 0; z < heights.depth; z++) {
+            float position[3] = { (float)x, heights.get(x, z), (float)z };
+            float normal[3];
+            uint8_t color[3];
+            exportVertexShading(heights, table, lightSource, x, z, normal, color);
+
+            writer.write(position, sizeof(position));
+            writer.write(normal, sizeof(normal));
+            writer.write(color, sizeof(color));
+        }
+    }
+
+    forEachTerrainTriangle(heights, [&](uint32_t a, uint32_t b, uint32_t c) {
+        uint8_t count = 3;
+        uint32_t face[3] = { a, b, c };
+        writer.write(&count, 1);
+        writer.write(face, sizeof(face));
+    });
+
+    return writer.close();
+}
+
+// glTF 2.0, picks .glb (one binary file) or .gltf (json + a .bin next to it) from the extension
+// the buffer holds every position, then every normal, every color (rgba bytes, glTF wants vertex attributes
+// 4 byte aligned) and finally the indices, one after the other so each one is a single streamed pass
+// a .glb can't be bigger than 4GB (its length fields are 32 bit), past that use .gltf
+inline bool exportTerrainGltf(const std::string& path, const Heightmap& heights, const BiomeTable& table, const float lightSource[3]) {
+    uint64_t vertices = terrainExportVertexCount(heights);
+    uint64_t indices = terrainExportTriangleCount(heights) * 3;
+    if (vertices == 0 || indices == 0 || vertices > UINT32_MAX || !exportHostIsLittleEndian()) return false;
+
+    uint64_t positionBytes = vertices * 12, normalBytes = vertices * 12, colorBytes = vertices * 4, indexBytes = indices * 4;
+    uint64_t normalOffset = positionBytes;
+    uint64_t colorOffset = normalOffset + normalBytes;
+    uint64_t indexOffset = colorOffset + colorBytes;
+    uint64_t binaryBytes = indexOffset + indexBytes;
+
+    // POSITION needs its bounds in the json, which comes first, so that's one quick pass over the heights
+    float minY = heights.get(0, 0), maxY = minY;
+    for (int x = 0; x < heights.width; x++) {
+        for (int z = 0; z < heights.depth; z++) {
+            minY = std::min(minY, heights.get(x, z));
+            maxY = std::max(maxY, heights.get(x, z));
+        }
+    }
+
+    bool binary = path.size() >= 4 && path.compare(path.size() - 4, 4, ".glb") == 0;
+    std::string binaryPath = path.substr(0, path.find_last_of('.')) + ".bin";
+    std::string binaryName = binaryPath.substr(binaryPath.find_last_of("/\\") + 1);
+
+    char bounds[160];
+    std::snprintf(bounds, sizeof(bounds), "\"min\":[0,%.9g,0],\"max\":[%d,%.9g,%d]", minY, heights.width - 1, maxY, heights.depth - 1);
+
+    auto view = [](uint64_t offset, uint64_t length, int target) {
+        return "{\"buffer\":0,\"byteOffset\":" + std::to_string(offset) + ",\"byteLength\":" + std::to_string(length)
+            + ",\"target\":" + std::to_string(target) + "}";
+    };
+
+    std::string json = std::string("{\"asset\":{\"version\":\"2.0\",\"generator\":\"project3\"},")
+        + "\"scene\":0,\"scenes\":[{\"nodes\":[0]}],\"nodes\":[{\"mesh\":0,\"name\":\"terrain\"}],"
+        + "\"meshes\":[{\"primitives\":[{\"attributes\":{\"POSITION\":0,\"NORMAL\":1,\"COLOR_0\":2},\"indices\":3,\"mode\":4}]}],"
+        + "\"accessors\":["
+        + "{\"bufferView\":0,\"componentType\":5126,\"count\":" + std::to_string(vertices) + ",\"type\":\"VEC3\"," + bounds + "},"
+        + "{\"bufferView\":1,\"componentType\":5126,\"count\":" + std::to_string(vertices) + ",\"type\":\"VEC3\"},"
+        + "{\"bufferView\":2,\"componentType\":5121,\"normalized\":true,\"count\":" + std::to_string(vertices) + ",\"type\":\"VEC4\"},"
+        + "{\"bufferView\":3,\"componentType\":5125,\"count\":" + std::to_string(indices) + ",\"type\":\"SCALAR\"}],"
+        + "\"bufferViews\":[" + view(0, positionBytes, 34962) + "," + view(normalOffset, normalBytes, 34962) + ","
+        + view(colorOffset, colorBytes, 34962) + "," + view(indexOffset, indexBytes, 34963) + "],"
+        + "\"buffers\":[{\"byteLength\":" + std::to_string(binaryBytes)
+        + (binary ? "" : ",\"uri\":\"" + binaryName + "\"") + "}]}";
+
+    // both glb chunks have to be 4 byte aligned, json pads with spaces and the binary chunk with zeros
+    size_t jsonPadding = (4 - json.size() % 4) % 4;
+    size_t binaryPadding = (4 - binaryBytes % 4) % 4;
+    uint64_t totalBytes = 12 + 8 + json.size() + jsonPadding + 8 + binaryBytes + binaryPadding;
+
+    if (binary && totalBytes > UINT32_MAX) {
+        std::fprintf(stderr, "Terrain is too big for a .glb (%.1f GB), export to .gltf instead\n", totalBytes / 1e9);
+        return false;
+    }
+
+    ExportWriter writer(binary ? path : binaryPath);
+
+    if (binary) {
+        writer.write("glTF", 4);
+        writer.writeValue<uint32_t>(2);
+        writer.writeValue<uint32_t>((uint32_t)totalBytes);
+
+        writer.writeValue<uint32_t>((uint32_t)(json.size() + jsonPadding));
+        writer.write("JSON", 4);
+        writer.write(json);
+        writer.pad(jsonPadding, ' ');
+
+        writer.writeValue<uint32_t>((uint32_t)(binaryBytes + binaryPadding));
+        writer.write("BIN\0", 4);
+    } else {
+        ExportWriter jsonWriter(path);
+        jsonWriter.write(json);
+        if (!jsonWriter.close()) return false;
+    }
+
+    for (int x = 0; x < heights.width; x++) {
+        for (int z = 0; z < heights.depth; z++) {
+            float position[3] = { (float)x, heights.get(x, z), (float)z };
+            writer.write(position, sizeof(position));
+        }
+    }
+
+    // normals and colors come out of the same calculation, so do them together a row at a time
+    // and hold the colors back in a row buffer until all the normals are written
+    // (that means two passes over the grid, but only one row of colors in memory)
+    for (int pass = 0; pass < 2; pass++) {
+        std::vector<uint8_t> rowColors((size_t)heights.depth * 4);
+
+        for (int x = 0; x < heights.width; x++) {
+            for (int z = 0; z < heights.depth; z++) {
+                float normal[3];
+                exportVertexShading(heights, table, lightSource, x, z, normal, &rowColors[z * 4]);
+                rowColors[z * 4 + 3] = 255;
+
+                if (pass == 0) writer.write(normal, sizeof(normal));
+            }
+
+            if (pass == 1) writer.write(rowColors.data(), rowColors.size());
+        }
+    }
+
+    forEachTerrainTriangle(heights, [&](uint32_t a, uint32_t b, uint32_t c) {
+        uint32_t triangle[3] = { a, b, c };
+        writer.write(triangle, sizeof(triangle));
+    });
+
+    if (binary) writer.pad(binaryPadding, 0);
+
+    return writer.close();
+}
+
+// picks the format from the file extension (.ply, .glb or .gltf)
+inline bool exportTerrain(const std::string& path, const Heightmap& heights, const BiomeTable& table, const float lightSource[3]) {
+    std::string extension = path.substr(path.find_last_of('.') + 1);
+    std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+
+    if (extension == "ply") return exportTerrainPly(path, heights, table, lightSource);
+    if (extension == "glb" || extension == "gltf") return exportTerrainGltf(path, heights, table, lightSource);
+
+    std::fprintf(stderr, "Don't know how to export %s (use .ply, .glb or .gltf)\n", path.c_str());
+    return false;
+}
@@ -0,0 +1,233 @@
+#pragma once
+
+#include <cstdint>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+
+#include "heightmap.h"
+#include "parallel.h"
+#include "noise.h"
+
+// bump this whenever the generator changes what it outputs, old cache files get thrown out
+const uint32_t terrainGeneratorVersion = 2;
+
+// anything below this after smoothing gets flattened to 0 so the low areas are a smooth surface
+const float terrainFloorHeight = 7.5f;
+
+// how far summateTerrainGridNeighbors looks in each direction
+const int smoothingRadius = 1;
+
+// raw (unsmoothed) heights of count grid positions (x, z0), (x, z0 + zStep), ... in world coordinates
+// continents from warped fBm, ridged mountains on top of them where the land is high enough
+inline void terrainHeightRow(int x, int z0, int zStep, int count, uint32_t seed, float* out) {
+    std::vector<float> xs(count), zs(count), continents(count), mountains(count);
+    for (int n = 0; n < count; n++) {
+        xs[n] = (float)x;
+        zs[n] = (float)(z0 + n * zStep);
+    }
+
+    NoiseLayer warp;
+    warp.octaves = 3;
+    warp.frequency = 1.0f / 400.0f;
+    warp.seed = seed * 4 + 0;
+    warpNoiseRow(warp, 80.0f, xs.data(), zs.data(), count);
+
+    NoiseLayer land;
+    land.octaves = 6;
+    land.frequency = 1.0f / 320.0f;
+    land.seed = seed * 4 + 1;
+    fbmNoiseRow(land, xs.data(), zs.data(), count, continents.data());
+
+    NoiseLayer ridges;
+    ridges.octaves = 5;
+    ridges.frequency = 1.0f / 180.0f;
+    ridges.ridged = true;
+    ridges.seed = seed * 4 + 2;
+    fbmNoiseRow(ridges, xs.data(), zs.data(), count, mountains.data());
+
+    for (int n = 0; n < count; n++) {
+        // mountains fade in as the continents rise, so the low areas stay flat
+        float mask = std::min(1.0f, std::max(0.0f, continents[n] * 2.0f + 0.3f));
+        out[n] = 14.0f + continents[n] * 30.0f + mountains[n] * mask * 32.0f;
+    }
+}
+
+// raw height of a single grid position, same numbers as the row version
+inline float terrainHeightAt(int x, int z, uint32_t seed) {
+    float height;
+    terrainHeightRow(x, z, 1, 1, seed, &height);
+    return height;
+}
+
+// fills the heightmap with raw heights, heightmap (i, j) is world position (originX + i * step, originZ + j * step)
+// heightmap rows run along z, so each x is one row of noise written straight into the heightmap
+// rows don't depend on each other, so they can be split over threads without changing the result
+// (compact heightmaps get each row made in floats first and then packed)
+inline void generateTerrainGrid(Heightmap& heights, int originX, int originZ, int step, uint32_t seed, int threadCount = 1) {
+    parallelFor(heights.width, threadCount, [&](int x) {
+        if (heights.data()) {
+            terrainHeightRow(originX + x * step, originZ, step, heights.depth, seed, heights.data() + (size_t)x * heights.depth);
+            return;
+        }
+
+        std::vector<float> row(heights.depth);
+        terrainHeightRow(originX + x * step, originZ, step, heights.depth, seed, row.data());
+        heights.setRow(x, row.data());
+    });
+}
+
+// a float heightmap's raw heights, reads without checking the storage every time
+// (the smoothing loops below are hot enough for that check to show up)
+struct FloatHeights {
+    const float* values;
+    int width, depth;
+
+    float get(int x, int z) const {
+        return values[(size_t)x * depth + z];
+    }
+};
+
+// average of the heights around a grid position, anything off the grid is skipped
+// (heights is a Heightmap or FloatHeights)
+template <typename Heights>
+inline float summateTerrainGridNeighbors(const Heights& heights, int gridX, int gridZ, int radius = smoothingRadius) {
+    int heightCount = 0;
+    float sum = 0;
+
+    for (int dx = -radius; dx <= radius; dx++) {
+        const int x = gridX + dx;
+        if(x < 0 || x >= heights.width) {
+            continue;
+        }
+
+        for (int dz = -radius; dz <= radius; dz++) {
+            const int z = gridZ + dz;
+            if(z < 0 || z >= heights.depth) {
+                continue;
+            }
+
+            // grid values are guarenteed to be safe now, so we can grab the value
+            heightCount++;
+            sum += heights.get(x, z);
+        }
+    }
+
+    return sum / heightCount;
+}
+
+// one 3x3 smoothing pass, set(x, z, height) stores each result
+template <typename Heights, typename Set>
+inline void smoothTerrainCells(const Heights& heights, const Set& set) {
+    for(int x = 0; x < heights.width; x++) {
+        for(int z = 0; z < heights.depth; z++) {
+            // 3x3 approach
+            // grab neighbors, and summate their heights
+            // plus, we cap the bottom so we have a smooth surface down there
+            float neighborSummation = summateTerrainGridNeighbors(heights, x, z);
+            if(neighborSummation < terrainFloorHeight) {
+                neighborSummation = 0.0f;
+            }
+
+            set(x, z, neighborSummation);
+        }
+    }
+}
+
+// one 3x3 smoothing pass from heights into smoothed (same size), either storage
+inline void smoothTerrainGrid(const Heightmap& heights, Heightmap& smoothed) {
+    if (heights.data() && smoothed.data()) {
+        FloatHeights source = { heights.data(), heights.width, heights.depth };
+        float* out = smoothed.data();
+        smoothTerrainCells(source, [&](int x, int z, float height) { out[(size_t)x * heights.depth + z] = height; });
+        return;
+    }
+
+    smoothTerrainCells(heights, [&](int x, int z, float height) { smoothed.set(x, z, height); });
+}
+
+// halo (ghost cell) smoothing
+// every smoothing pass reads smoothingRadius cells past the cell it writes, so after n passes a cell depends
+// on everything within n * smoothingRadius of it. if a tile is cut out with that much extra border (the halo)
+// the tile's own cells come out exactly the same as smoothing the whole grid would give them:
+// the halo cells themselves go wrong from the outside in, but they never get far enough in to matter.
+// at the edge of a bounded world the halo just gets cut off, which skips the same neighbors the
+// whole grid pass skips, so those cells match too (same values, added in the same order, bit for bit)
+
+inline int smoothingHalo(int passes) {
+    return smoothingRadius * passes;
+}
+
+// smooths a window (tile + halo) in place, scratch gets resized to match
+inline void smoothTerrainWindow(Heightmap& window, Heightmap& scratch, int passes) {
+    if (scratch.width != window.width || scratch.depth != window.depth) {
+        scratch.resize(window.width, window.depth);
+    }
+
+    for (int i = 0; i < passes; i++) {
+        smoothTerrainGrid(window, scratch);
+        window.swap(scratch);
+    }
+}
+
+// generates + smooths the part of an unbounded world starting at (originX, originZ), out keeps its size
+// the halo is generated around it and thrown away after, so neighboring windows line up seamlessly
+inline void generateSmoothedTerrainWindow(Heightmap& out, int originX, int originZ, int step, uint32_t seed, int passes) {
+    int halo = smoothingHalo(passes);
+
+    Heightmap window(out.width + 2 * halo, out.depth + 2 * halo), scratch;
+    generateTerrainGrid(window, originX - halo * step, originZ - halo * step, step, seed);
+    smoothTerrainWindow(window, scratch, passes);
+
+    for (int x = 0; x < out.width; x++) {
+        for (int z = 0; z < out.depth; z++) {
+            out.set(x, z, window.get(x + halo, z + halo));
+        }
+    }
+}
+
+// recomputes just the core region of smoothed from heights, exactly the same as smoothing the whole grid
+// (the window it smooths is the core plus the halo, cut off at the edges of the grid)
+inline void smoothTerrainRegion(const Heightmap& heights, Heightmap& smoothed, const HeightmapRegion& core, int passes) {
+    HeightmapRegion window = core.expanded(smoothingHalo(passes), heights.width, heights.depth);
+
+    // the window itself is always float, compact heights only get converted on the way in and out
+    Heightmap windowHeights(window.x1 - window.x0, window.z1 - window.z0), scratch;
+    for (int x = window.x0; x < window.x1; x++) {
+        float* row = windowHeights.data() + (size_t)(x - window.x0) * windowHeights.depth;
+        if (heights.data()) {
+            std::copy(heights.data() + (size_t)x * heights.depth + window.z0, heights.data() + (size_t)x * heights.depth + window.z1, row);
+        } else {
+            for (int z = window.z0; z < window.z1; z++) row[z - window.z0] = heights.get(x, z);
+        }
+    }
+
+    smoothTerrainWindow(windowHeights, scratch, passes);
+
+    // only the core goes back, so tiles never write over each other
+    for (int x = core.x0; x < core.x1; x++) {
+        const float* row = windowHeights.data() + (size_t)(x - window.x0) * windowHeights.depth - window.z0;
+        if (smoothed.data()) {
+            std::copy(row + core.z0, row + core.z1, smoothed.data() + (size_t)x * smoothed.depth + core.z0);
+        } else {
+            for (int z = core.z0; z < core.z1; z++) smoothed.set(x, z, row[z]);
+        }
+    }
+}
+
+// same result as calling smoothTerrainGrid passes times on the whole grid, but done tile by tile
+// (each with its own halo) across threadCount threads, smoothed has to be the same size as heights
+inline void smoothTerrainGridTiled(const Heightmap& heights, Heightmap& smoothed, int passes, int tileSize, int threadCount) {
+    int tilesX = (heights.width + tileSize - 1) / tileSize;
+    int tilesZ = (heights.depth + tileSize - 1) / tileSize;
+
+    parallelFor(tilesX * tilesZ, threadCount, [&](int tile) {
+        HeightmapRegion core;
+        core.x0 = (tile / tilesZ) * tileSize;
+        core.z0 = (tile % tilesZ) * tileSize;
+        core.x1 = std::min(core.x0 + tileSize, heights.width);
+        core.z1 = std::min(core.z0 + tileSize, heights.depth);
+
+        smoothTerrainRegion(heights, smoothed, core, passes);
+    });
+}
@@ -0,0 +1,553 @@
+#pragma once
+
+#include <GLFW/glfw3.h>
+
+#include <vector>
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+
+#include "heightmap.h"
+#include "biome.h"
+#include "frustum.h"
+#include "heightmap_pyramid.h"
+
+// chunked level of detail for the terrain
+// the grid is cut into chunkSize x chunkSize quad chunks, and the chunks are grouped into a quadtree
+// every node draws chunkSize x chunkSize quads no matter how big it is, so a node one level up
+// covers twice the area using every other vertex (step 2, then 4, 8...)
+// each frame we walk down the tree and stop as soon as a node's error is small enough on screen,
+// so the triangle count depends on the screen and not on how big the map is
+
+// edges of a node, used to flag which sides border a coarser neighbor
+enum TerrainEdge {
+    EDGE_WEST = 1,  // x - 1
+    EDGE_EAST = 2,  // x + 1
+    EDGE_NORTH = 4, // z - 1
+    EDGE_SOUTH = 8  // z + 1
+};
+
+struct TerrainNode {
+    int x, z;       // grid origin of the node
+    int level;      // 0 is full resolution, step is 1 << level
+    float minY, maxY;
+    float error;    // worst height difference against the full resolution grid (world units)
+    int children[4] = { -1, -1, -1, -1 };
+};
+
+// what the lod selection needs to know about the camera
+struct LodView {
+    float pixelsPerUnit = 1.0f; // for perspective this is at a distance of 1
+    bool perspective = false;
+    float eyeX = 0, eyeY = 0, eyeZ = 0;
+    float maxPixelError = 2.0f;
+    float minCellPixels = 2.0f; // don't split once a cell would be smaller than this on screen
+
+    Frustum frustum;
+    bool cull = true;
+};
+
+// reads the current projection / modelview matrices and viewport back out of opengl
+// the eye position is in terrain space, so call this after all the glTranslate / glRotate calls
+inline LodView makeLodView(float maxPixelError, float minCellPixels) {
+    float projection[16], modelview[16];
+    GLint viewport[4];
+    glGetFloatv(GL_PROJECTION_MATRIX, projection);
+    glGetFloatv(GL_MODELVIEW_MATRIX, modelview);
+    glGetIntegerv(GL_VIEWPORT, viewport);
+
+    LodView view;
+    view.maxPixelError = maxPixelError;
+    view.minCellPixels = minCellPixels;
+    view.frustum = Frustum::fromCurrentMatrices();
+    view.perspective = projection[15] == 0.0f;
+    view.pixelsPerUnit = std::fabs(projection[5]) * viewport[3] * 0.5f;
+
+    // the modelview is a rotation + translation, so the eye is -R^T * t
+    float tx = modelview[12], ty = modelview[13], tz = modelview[14];
+    view.eyeX = -(modelview[0] * tx + modelview[1] * ty + modelview[2] * tz);
+    view.eyeY = -(modelview[4] * tx + modelview[5] * ty + modelview[6] * tz);
+    view.eyeZ = -(modelview[8] * tx + modelview[9] * ty + modelview[10] * tz);
+
+    return view;
+}
+
+class TerrainQuadtree {
+    private:
+        const Heightmap* terrain = nullptr;
+        const std::vector<uint8_t>* biomes = nullptr; // per vertex biome index, same layout as terrain
+        const BiomeTable* biomeTable = nullptr;
+        HeightmapPyramid pyramid;
+        int chunkSize = 32;
+        int levelCount = 0;
+        int cellsX = 0, cellsZ = 0; // size of the grid in level 0 chunks
+
+        std::vector<TerrainNode> nodes;
+        std::vector<int> selected, nextSelected;
+        std::vector<uint8_t> levelMap; // level of the selected node covering each level 0 chunk (or notDrawn)
+        std::vector<int> xs, zs;
+        std::vector<float> vertexHeights;
+        std::vector<uint8_t> vertexBiomes;
+
+        static constexpr uint8_t notDrawn = 255;
+
+        int lastX() const { return terrain->width - 1; }
+        int lastZ() const { return terrain->depth - 1; }
+
+        int buildNode(int x, int z, int level) {
+            if (x >= lastX() || z >= lastZ()) {
+                return -1;
+            }
+
+            int index = nodes.size();
+            nodes.push_back(TerrainNode());
+            nodes[index].x = x;
+            nodes[index].z = z;
+            nodes[index].level = level;
+
+            if (level == 0) {
+                computeLeafBounds(nodes[index]);
+                return index;
+            }
+
+            int half = (chunkSize << level) / 2;
+            int children[4] = {
+                buildNode(x, z, level - 1),
+                buildNode(x + half, z, level - 1),
+                buildNode(x, z + half, level - 1),
+                buildNode(x + half, z + half, level - 1)
+            };
+
+            for (int i = 0; i < 4; i++) {
+                nodes[index].children[i] = children[i];
+            }
+            combineChildren(nodes[index]);
+
+            return index;
+        }
+
+        // bounds + error of an inner node from its children
+        void combineChildren(TerrainNode& node) {
+            node.minY = 1e30f;
+            node.maxY = -1e30f;
+            node.error = 0.0f;
+            for (int child : node.children) {
+                if (child < 0) continue;
+
+                node.minY = std::min(node.minY, nodes[child].minY);
+                node.maxY = std::max(node.maxY, nodes[child].maxY);
+                node.error = std::max(node.error, nodes[child].error);
+            }
+
+
+            // we only compare against the children's grid instead of every full resolution vertex
+            // (which would be way too slow on big maps), and keep the worst of that and the children's error
+            // so a parent never claims to be more accurate than its children
+            node.error = std::max(node.error, measureApproximationError(node));
+        }
+
+        // redoes the nodes touching region (and only those), children before parents
+        void refreshNode(int index, const HeightmapRegion& region) {
+            TerrainNode& node = nodes[index];
+            int size = chunkSize << node.level;
+            HeightmapRegion area = { node.x, node.z, std::min(node.x + size, lastX()) + 1, std::min(node.z + size, lastZ()) + 1 };
+            if (!area.overlaps(region)) return;
+
+            if (node.level == 0) {
+                computeLeafBounds(node);
+                return;
+            }
+
+            for (int child : node.children) {
+                if (child >= 0) refreshNode(child, region);
+            }
+            combineChildren(nodes[index]);
+        }
+
+        // chunks line up with pyramid nodes (for power of two chunk sizes), so this is one lookup
+        void computeLeafBounds(TerrainNode& node) {
+            HeightmapRegion area = { node.x, node.z, std::min(node.x + chunkSize, lastX()) + 1, std::min(node.z + chunkSize, lastZ()) + 1 };
+            pyramid.bounds(area, node.minY, node.maxY);
+            node.error = 0.0f;
+        }
+
+        // bilinear height of the node's own (coarse) grid at a grid position inside the node
+        float sampleCoarse(const TerrainNode& node, int x, int z) const {
+            int step = 1 << node.level;
+            int endX = std::min(node.x + chunkSize * step, lastX());
+            int endZ = std::min(node.z + chunkSize * step, lastZ());
+
+            int x0 = node.x + ((x - node.x) / step) * step;
+            int z0 = node.z + ((z - node.z) / step) * step;
+            int x1 = std::min(x0 + step, endX);
+            int z1 = std::min(z0 + step, endZ);
+
+            float fx = (x1 == x0) ? 0.0f : (float)(x - x0) / (x1 - x0);
+            float fz = (z1 == z0) ? 0.0f : (float)(z - z0) / (z1 - z0);
+
+            float top = terrain->get(x0, z0) + (terrain->get(x1, z0) - terrain->get(x0, z0)) * fx;
+            float bottom = terrain->get(x0, z1) + (terrain->get(x1, z1) - terrain->get(x0, z1)) * fx;
+            return top + (bottom - top) * fz;
+        }
+
+        float measureApproximationError(const TerrainNode& node) const {
+            int step = 1 << node.level;
+            int childStep = step / 2;
+            int endX = std::min(node.x + chunkSize * step, lastX());
+            int endZ = std::min(node.z + chunkSize * step, lastZ());
+
+            float error = 0.0f;
+            for (int x = node.x; x <= endX; x += childStep) {
+                for (int z = node.z; z <= endZ; z += childStep) {
+                    error = std::max(error, std::fabs(terrain->get(x, z) - sampleCoarse(node, x, z)));
+                }
+            }
+
+            return error;
+        }
+
+        // screen pixels per world unit at the node, for ortho it's the same everywhere
+        float pixelsPerUnitAt(const TerrainNode& node, const LodView& view) const {
+            if (!view.perspective) {
+                return view.pixelsPerUnit;
+            }
+
+            // distance from the eye to the node's bounding box
+            int size = chunkSize << node.level;
+            float dx = std::max({ node.x - view.eyeX, 0.0f, view.eyeX - (node.x + size) });
+            float dy = std::max({ node.minY - view.eyeY, 0.0f, view.eyeY - node.maxY });
+            float dz = std::max({ node.z - view.eyeZ, 0.0f, view.eyeZ - (node.z + size) });
+            float distance = std::max(std::sqrt(dx * dx + dy * dy + dz * dz), 1e-3f);
+
+            return view.pixelsPerUnit / distance;
+        }
+
+        bool shouldSplit(const TerrainNode& node, const LodView& view) const {
+            if (node.level == 0) {
+                return false;
+            }
+
+            float pixelsPerUnit = pixelsPerUnitAt(node, view);
+
+            // splitting halves the cell size, if those cells would be smaller than a couple pixels
+            // the extra detail can't show up on screen anyway (it's just noise at that point)
+            float childCellPixels = (1 << (node.level - 1)) * pixelsPerUnit;
+            if (childCellPixels < view.minCellPixels) {
+                return false;
+            }
+
+            return node.error * pixelsPerUnit > view.maxPixelError;
+        }
+
+        bool isVisible(const TerrainNode& node, const LodView& view) const {
+            if (!view.cull) {
+                return true;
+            }
+
+            int size = chunkSize << node.level;
+            float maxX = std::min(node.x + size, lastX());
+            float maxZ = std::min(node.z + size, lastZ());
+
+            return view.frustum.intersectsBox(node.x, node.minY, node.z, maxX, node.maxY, maxZ);
+        }
+
+        // how many full resolution chunks a node covers, the ones hanging off the end of the grid don't count
+        int chunkCount(const TerrainNode& node) const {
+            int cellX = node.x / chunkSize;
+            int cellZ = node.z / chunkSize;
+            int cells = 1 << node.level;
+
+            return (std::min(cellX + cells, cellsX) - cellX) * (std::min(cellZ + cells, cellsZ) - cellZ);
+        }
+
+        void selectNode(int index, const LodView& view) {
+            const TerrainNode& node = nodes[index];
+
+            // nothing under a node outside the frustum can be visible either, so the whole subtree goes
+            if (!isVisible(node, view)) {
+                culledChunks += chunkCount(node);
+                return;
+            }
+
+            if (!shouldSplit(node, view)) {
+                selected.push_back(index);
+                return;
+            }
+
+            for (int child : node.children) {
+                if (child >= 0) {
+                    selectNode(child, view);
+                }
+            }
+        }
+
+        void markLevel(const TerrainNode& node, uint8_t level) {
+            int cellX = node.x / chunkSize;
+            int cellZ = node.z / chunkSize;
+            int cells = 1 << node.level;
+
+            for (int x = cellX; x < std::min(cellX + cells, cellsX); x++) {
+                for (int z = cellZ; z < std::min(cellZ + cells, cellsZ); z++) {
+                    levelMap[(size_t)x * cellsZ + z] = level;
+                }
+            }
+        }
+
+        // level of the selected node just past the given edge, or -1 past the end of the grid
+        // when several nodes touch the edge we return the lowest level of them
+        int neighborLevel(const TerrainNode& node, int edge) const {
+            int cellX = node.x / chunkSize;
+            int cellZ = node.z / chunkSize;
+            int cells = 1 << node.level;
+
+            int fromX = cellX, toX = cellX + cells;
+            int fromZ = cellZ, toZ = cellZ + cells;
+            if (edge == EDGE_WEST) { fromX = cellX - 1; toX = cellX; }
+            if (edge == EDGE_EAST) { fromX = cellX + cells; toX = fromX + 1; }
+            if (edge == EDGE_NORTH) { fromZ = cellZ - 1; toZ = cellZ; }
+            if (edge == EDGE_SOUTH) { fromZ = cellZ + cells; toZ = fromZ + 1; }
+
+            fromX = std::max(fromX, 0);
+            fromZ = std::max(fromZ, 0);
+            toX = std::min(toX, cellsX);
+            toZ = std::min(toZ, cellsZ);
+
+            int level = -1;
+            for (int x = fromX; x < toX; x++) {
+                for (int z = fromZ; z < toZ; z++) {
+                    int cellLevel = levelMap[(size_t)x * cellsZ + z];
+                    if (cellLevel == notDrawn) continue;
+
+                    level = (level < 0) ? cellLevel : std::min(level, cellLevel);
+                }
+            }
+
+            return level;
+        }
+
+        // neighbors are only allowed to be one level apart, that way a coarse edge has exactly
+        // one fine vertex between each of its own and stitching is just moving that vertex onto the line
+        void balanceSelection(const LodView& view) {
+            std::fill(levelMap.begin(), levelMap.end(), notDrawn);
+            for (int index : selected) {
+                markLevel(nodes[index], nodes[index].level);
+            }
+
+            bool changed = true;
+            while (changed) {
+                changed = false;
+                nextSelected.clear();
+
+                for (int index : selected) {
+                    const TerrainNode& node = nodes[index];
+
+                    bool split = false;
+                    if (node.level > 1) {
+                        for (int edge : { EDGE_WEST, EDGE_EAST, EDGE_NORTH, EDGE_SOUTH }) {
+                            int level = neighborLevel(node, edge);
+                            if (level >= 0 && level < node.level - 1) {
+                                split = true;
+                                break;
+                            }
+                        }
+                    }
+
+                    if (!split) {
+                        nextSelected.push_back(index);
+                        continue;
+                    }
+
+                    changed = true;
+                    for (int child : node.children) {
+                        if (child < 0) continue;
+
+                        if (!isVisible(nodes[child], view)) {
+                            culledChunks += chunkCount(nodes[child]);
+                            markLevel(nodes[child], notDrawn);
+                        } else {
+                            nextSelected.push_back(child);
+                            markLevel(nodes[child], nodes[child].level);
+                        }
+                    }
+                }
+
+                selected.swap(nextSelected);
+            }
+        }
+
+        int coarserEdges(const TerrainNode& node) const {
+            int edges = 0;
+            for (int edge : { EDGE_WEST, EDGE_EAST, EDGE_NORTH, EDGE_SOUTH }) {
+                if (neighborLevel(node, edge) > node.level) {
+                    edges |= edge;
+                }
+            }
+
+            return edges;
+        }
+
+        int drawNode(const TerrainNode& node, int edges, const float lightSource[3]) {
+            int step = 1 << node.level;
+            int endX = std::min(node.x + chunkSize * step, lastX());
+            int endZ = std::min(node.z + chunkSize * step, lastZ());
+
+            // grid positions of the node's vertices, the last one gets clamped to the edge of the grid
+            xs.clear();
+            zs.clear();
+            for (int x = node.x; ; x += step) {
+                xs.push_back(std::min(x, endX));
+                if (x >= endX) break;
+            }
+            for (int z = node.z; ; z += step) {
+                zs.push_back(std::min(z, endZ));
+                if (z >= endZ) break;
+            }
+
+            int columns = zs.size();
+            vertexHeights.resize(xs.size() * columns);
+            vertexBiomes.resize(xs.size() * columns);
+            for (size_t i = 0; i < xs.size(); i++) {
+                for (int j = 0; j < columns; j++) {
+                    vertexHeights[i * columns + j] = terrain->get(xs[i], zs[j]);
+                    vertexBiomes[i * columns + j] = (*biomes)[(size_t)xs[i] * terrain->depth + zs[j]];
+                }
+            }
+
+            // stitch against coarser neighbors
+            // every odd vertex on that edge is moved onto the line between its two even neighbors,
+            // which is exactly where the neighbor's edge runs, so no cracks open up between them
+            auto stitch = [&](int fixedIndex, bool alongZ) {
+                const std::vector<int>& coords = alongZ ? zs : xs;
+                int end = alongZ ? endZ : endX;
+
+                for (size_t k = 1; k + 1 < coords.size(); k += 2) {
+                    int a = coords[k] - step;
+                    int b = std::min(coords[k] + step, end);
+                    float t = (float)(coords[k] - a) / (b - a);
+
+                    float heightA, heightB;
+                    if (alongZ) {
+                        heightA = terrain->get(xs[fixedIndex], a);
+                        heightB = terrain->get(xs[fixedIndex], b);
+                        vertexHeights[fixedIndex * columns + k] = heightA + (heightB - heightA) * t;
+                    } else {
+                        heightA = terrain->get(a, zs[fixedIndex]);
+                        heightB = terrain->get(b, zs[fixedIndex]);
+                        vertexHeights[k * columns + fixedIndex] = heightA + (heightB - heightA) * t;
+                    }
+                }
+            };
+
+            if (edges & EDGE_WEST) stitch(0, true);
+            if (edges & EDGE_EAST) stitch(xs.size() - 1, true);
+            if (edges & EDGE_NORTH) stitch(0, false);
+            if (edges & EDGE_SOUTH) stitch(columns - 1, false);
+
+            int triangles = 0;
+
+            glBegin(GL_TRIANGLES);
+            for (size_t i = 0; i + 1 < xs.size(); i++) {
+                for (int j = 0; j + 1 < columns; j++) {
+                    float x0 = xs[i], x1 = xs[i + 1];
+                    float z0 = zs[j], z1 = zs[j + 1];
+
+                    float h00 = vertexHeights[i * columns + j];
+                    float h10 = vertexHeights[(i + 1) * columns + j];
+                    float h11 = vertexHeights[(i + 1) * columns + j + 1];
+                    float h01 = vertexHeights[i * columns + j + 1];
+
+                    float normalX, normalY, normalZ;
+                    calculateHeightmapNormal(h00, h10, h01, (float)step, normalX, normalY, normalZ);
+
+                    float dot = (normalX * lightSource[0]) + (normalY * lightSource[1]) + (normalZ * lightSource[2]);
+                    float diffuse = std::max(0.2f, std::min(1.0f, dot));
+
+                    uint8_t b00 = vertexBiomes[i * columns + j];
+                    uint8_t b10 = vertexBiomes[(i + 1) * columns + j];
+                    uint8_t b11 = vertexBiomes[(i + 1) * columns + j + 1];
+                    uint8_t b01 = vertexBiomes[i * columns + j + 1];
+
+                    // same winding as the GL_QUADS polygons, split along the (x0, z0) -> (x1, z1) diagonal
+                    biomeTable->setColor(b00, diffuse); glVertex3f(x0, h00, z0);
+                    biomeTable->setColor(b10, diffuse); glVertex3f(x1, h10, z0);
+                    biomeTable->setColor(b11, diffuse); glVertex3f(x1, h11, z1);
+
+                    biomeTable->setColor(b00, diffuse); glVertex3f(x0, h00, z0);
+                    biomeTable->setColor(b11, diffuse); glVertex3f(x1, h11, z1);
+                    biomeTable->setColor(b01, diffuse); glVertex3f(x0, h01, z1);
+
+                    triangles += 2;
+                }
+            }
+            glEnd();
+
+            return triangles;
+        }
+
+    public:
+        int root = -1;
+
+        // stats from the last draw call
+        int drawnNodes = 0;
+        // both in full resolution chunks, so they mean the same thing whatever level a node was drawn or culled at
+        // (and add up to every chunk on the grid)
+        int visibleChunks = 0;
+        int culledChunks = 0;
+        int drawnTriangles = 0;
+
+        // the biomes and table are only read when drawing, so reclassifying them doesn't need a rebuild
+        void build(const Heightmap& heightmap, const std::vector<uint8_t>& biomeIndices, const BiomeTable& table, int size = 32) {
+            terrain = &heightmap;
+            biomes = &biomeIndices;
+            biomeTable = &table;
+            chunkSize = size;
+
+            cellsX = (lastX() + chunkSize - 1) / chunkSize;
+            cellsZ = (lastZ() + chunkSize - 1) / chunkSize;
+
+            levelCount = 1;
+            while ((chunkSize << (levelCount - 1)) < std::max(lastX(), lastZ())) {
+                levelCount++;
+            }
+
+            pyramid.build(heightmap);
+
+            nodes.clear();
+            root = buildNode(0, 0, levelCount - 1);
+
+            levelMap.assign((size_t)cellsX * cellsZ, notDrawn);
+        }
+
+        // the heights changed (erosion, editing...), redo the bounds and errors for the same terrain
+        void refresh() {
+            if (terrain) build(*terrain, *biomes, *biomeTable, chunkSize);
+        }
+
+        // only the heights inside region changed, the work depends on the size of region instead of the map
+        void refreshRegion(const HeightmapRegion& region) {
+            if (root < 0 || region.empty()) return;
+
+            pyramid.update(region);
+            refreshNode(root, region);
+        }
+
+        void draw(const LodView& view, const float lightSource[3]) {
+            selected.clear();
+            drawnNodes = 0;
+            visibleChunks = 0;
+            culledChunks = 0;
+            drawnTriangles = 0;
+
+            if (root < 0) return;
+
+            selectNode(root, view);
+            balanceSelection(view);
+
+            for (int index : selected) {
+                const TerrainNode& node = nodes[index];
+                drawnTriangles += drawNode(node, coarserEdges(node), lightSource);
+                drawnNodes++;
+                visibleChunks += chunkCount(node);
+            }
+        }
+};
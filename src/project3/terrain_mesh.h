@@ -0,0 +1,388 @@
+#pragma once
+
+#include <GLFW/glfw3.h>
+
+#include <vector>
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+
+#include "heightmap.h"
+#include "biome.h"
+#include "gl_buffers.h"
+
+// indexed terrain mesh
+// every grid vertex is stored once and the triangles point at it by index, unlike the Polygon path
+// where every quad carries its own copy of its 4 corners (so interior vertices show up 4 times)
+//
+// the index order matters for the gpu's post transform vertex cache, a vertex that's still in the cache
+// doesn't get transformed again. we measure that with the average cache miss ratio (ACMR), the number of
+// vertices transformed per triangle: 3 is the worst, ~0.5 is the best a grid can do
+
+enum MeshOrder {
+    MESH_ROWS,    // plain triangle list, one row of quads after the other
+    MESH_STRIPS,  // one triangle strip per row, rows joined with degenerate triangles
+    MESH_FORSYTH  // triangle list reordered for the vertex cache (Forsyth's linear speed optimizer)
+};
+
+struct TerrainMesh {
+    std::vector<float> positions; // xyz per vertex
+    std::vector<float> colors;    // rgb per vertex, biome color with the lighting baked in
+    std::vector<float> diffuse;   // lighting per vertex, kept so the colors can be redone without the normals
+    std::vector<uint32_t> indices;
+    GLenum primitive = GL_TRIANGLES;
+
+    // grid region the vertices came from, [x0, x1] x [z0, z1]
+    int x0 = 0, z0 = 0, x1 = -1, z1 = -1;
+
+    // vertex buffers (0 until the first draw, or for good if the driver doesn't have them)
+    // dirty is what changed on the cpu side since the last upload, in grid coordinates
+    GLuint positionBuffer = 0, colorBuffer = 0, indexBuffer = 0;
+    HeightmapRegion dirty;
+    bool uploaded = false;
+
+    HeightmapRegion region() const {
+        return { x0, z0, x1 + 1, z1 + 1 };
+    }
+
+    size_t vertexIndex(int x, int z) const {
+        return (size_t)(x - x0) * (z1 - z0 + 1) + (z - z0);
+    }
+
+    // picks up new heights (and the lighting that goes with them) for the vertices in area, colors need a
+    // colorize after. normals look one vertex ahead, so area should already include the vertices next to
+    // whatever heights changed
+    void updateHeights(const Heightmap& heights, const HeightmapRegion& area, const float lightSource[3]) {
+        diffuse.resize((size_t)(x1 - x0 + 1) * (z1 - z0 + 1));
+        positions.resize(diffuse.size() * 3);
+
+        HeightmapRegion clipped = area.expanded(0, x1 + 1, z1 + 1);
+        clipped.x0 = std::max(clipped.x0, x0);
+        clipped.z0 = std::max(clipped.z0, z0);
+
+        for (int x = clipped.x0; x < clipped.x1; x++) {
+            for (int z = clipped.z0; z < clipped.z1; z++) {
+                size_t vertex = vertexIndex(x, z);
+                positions[vertex * 3] = x;
+                positions[vertex * 3 + 1] = heights.get(x, z);
+                positions[vertex * 3 + 2] = z;
+
+                float normalX, normalY, normalZ;
+                calculateHeightmapNormalAt(heights, x, z, normalX, normalY, normalZ);
+
+                float dot = (normalX * lightSource[0]) + (normalY * lightSource[1]) + (normalZ * lightSource[2]);
+                diffuse[vertex] = std::max(0.2f, std::min(1.0f, dot));
+            }
+        }
+
+        dirty = dirty.merged(clipped);
+    }
+
+    void updateHeights(const Heightmap& heights, const float lightSource[3]) {
+        updateHeights(heights, region(), lightSource);
+    }
+
+    // recomputes the colors in area from (re)classified biomes, biomes covers the whole grid the mesh was cut from
+    void colorize(const std::vector<uint8_t>& biomes, int gridDepth, const BiomeTable& table, const HeightmapRegion& area) {
+        colors.resize(diffuse.size() * 3);
+
+        HeightmapRegion clipped = area.expanded(0, x1 + 1, z1 + 1);
+        clipped.x0 = std::max(clipped.x0, x0);
+        clipped.z0 = std::max(clipped.z0, z0);
+
+        for (int x = clipped.x0; x < clipped.x1; x++) {
+            for (int z = clipped.z0; z < clipped.z1; z++) {
+                size_t vertex = vertexIndex(x, z);
+                const float* color = table.color(biomes[(size_t)x * gridDepth + z]);
+                for (int k = 0; k < 3; k++) colors[vertex * 3 + k] = color[k] * diffuse[vertex];
+            }
+        }
+
+        dirty = dirty.merged(clipped);
+    }
+
+    void colorize(const std::vector<uint8_t>& biomes, int gridDepth, const BiomeTable& table) {
+        colorize(biomes, gridDepth, table, region());
+    }
+
+    int triangleCount() const {
+        if (primitive == GL_TRIANGLES) return indices.size() / 3;
+
+        // strips, not counting the degenerate ones
+        int count = 0;
+        for (size_t i = 2; i < indices.size(); i++) {
+            uint32_t a = indices[i - 2], b = indices[i - 1], c = indices[i];
+            if (a != b && b != c && a != c) count++;
+        }
+        return count;
+    }
+
+    // the whole mesh the first time, after that only the dirty part. the vertices of one grid row are next
+    // to each other in the buffer, so that's one glBufferSubData per dirty row per buffer and the upload
+    // grows with the size of the edit instead of the size of the mesh
+    void upload() {
+        const GLBufferFunctions& gl = glBufferFunctions();
+        if (!gl.available()) return;
+
+        if (!uploaded) {
+            GLuint buffers[3];
+            gl.genBuffers(3, buffers);
+            positionBuffer = buffers[0];
+            colorBuffer = buffers[1];
+            indexBuffer = buffers[2];
+
+            gl.bindBuffer(GL_ARRAY_BUFFER, positionBuffer);
+            gl.bufferData(GL_ARRAY_BUFFER, positions.size() * sizeof(float), positions.data(), GL_DYNAMIC_DRAW);
+            gl.bindBuffer(GL_ARRAY_BUFFER, colorBuffer);
+            gl.bufferData(GL_ARRAY_BUFFER, colors.size() * sizeof(float), colors.data(), GL_DYNAMIC_DRAW);
+            gl.bindBuffer(GL_ARRAY_BUFFER, 0);
+
+            gl.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+            gl.bufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(uint32_t), indices.data(), GL_STATIC_DRAW);
+            gl.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+            uploaded = true;
+        } else if (!dirty.empty()) {
+            size_t rowBytes = (size_t)(dirty.z1 - dirty.z0) * 3 * sizeof(float);
+
+            for (GLuint buffer : { positionBuffer, colorBuffer }) {
+                const std::vector<float>& source = (buffer == positionBuffer) ? positions : colors;
+
+                gl.bindBuffer(GL_ARRAY_BUFFER, buffer);
+                for (int x = dirty.x0; x < dirty.x1; x++) {
+                    size_t first = vertexIndex(x, dirty.z0) * 3;
+                    gl.bufferSubData(GL_ARRAY_BUFFER, first * sizeof(float), rowBytes, source.data() + first);
+                }
+            }
+            gl.bindBuffer(GL_ARRAY_BUFFER, 0);
+        }
+
+        dirty = HeightmapRegion();
+    }
+
+    void draw() {
+        upload();
+
+        // with buffers bound the pointers are offsets into them, otherwise they point at our arrays
+        const GLBufferFunctions& gl = glBufferFunctions();
+        const void* positionData = uploaded ? nullptr : positions.data();
+        const void* colorData = uploaded ? nullptr : colors.data();
+        const void* indexData = uploaded ? nullptr : indices.data();
+
+        glEnableClientState(GL_VERTEX_ARRAY);
+        glEnableClientState(GL_COLOR_ARRAY);
+        if (uploaded) gl.bindBuffer(GL_ARRAY_BUFFER, positionBuffer);
+        glVertexPointer(3, GL_FLOAT, 0, positionData);
+        if (uploaded) gl.bindBuffer(GL_ARRAY_BUFFER, colorBuffer);
+        glColorPointer(3, GL_FLOAT, 0, colorData);
+        if (uploaded) gl.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+
+        glDrawElements(primitive, indices.size(), GL_UNSIGNED_INT, indexData);
+
+        if (uploaded) {
+            gl.bindBuffer(GL_ARRAY_BUFFER, 0);
+            gl.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+        }
+        glDisableClientState(GL_COLOR_ARRAY);
+        glDisableClientState(GL_VERTEX_ARRAY);
+    }
+};
+
+// simulates a fifo vertex cache over the index stream and returns misses per triangle
+inline float computeACMR(const std::vector<uint32_t>& indices, int triangles, int cacheSize = 32) {
+    std::vector<uint32_t> cache(cacheSize, UINT32_MAX);
+    int head = 0;
+    long misses = 0;
+
+    for (uint32_t index : indices) {
+        if (std::find(cache.begin(), cache.end(), index) != cache.end()) continue;
+
+        cache[head] = index;
+        head = (head + 1) % cacheSize;
+        misses++;
+    }
+
+    return triangles > 0 ? (float)misses / triangles : 0.0f;
+}
+
+// reorders a triangle list for an lru vertex cache, see Tom Forsyth's "Linear-Speed Vertex Cache Optimisation"
+// greedy: always emit the triangle whose vertices score best, vertices score high when they're near the front
+// of the cache and when they only have a few triangles left (so we finish off areas instead of leaving holes)
+inline void optimizeVertexCacheForsyth(std::vector<uint32_t>& indices, int vertexCount) {
+    const int cacheSize = 32;
+    const float cacheDecayPower = 1.5f;
+    const float lastTriangleScore = 0.75f;
+    const float valenceBoostScale = 2.0f;
+    const float valenceBoostPower = 0.5f;
+
+    int triangleCount = indices.size() / 3;
+    if (triangleCount == 0) return;
+
+    // triangles using each vertex, compressed into one array
+    std::vector<int> valence(vertexCount, 0), offsets(vertexCount + 1, 0);
+    for (uint32_t index : indices) valence[index]++;
+    for (int v = 0; v < vertexCount; v++) offsets[v + 1] = offsets[v] + valence[v];
+
+    std::vector<int> vertexTriangles(indices.size()), fill(offsets.begin(), offsets.end() - 1);
+    for (int t = 0; t < triangleCount; t++) {
+        for (int k = 0; k < 3; k++) {
+            vertexTriangles[fill[indices[t * 3 + k]]++] = t;
+        }
+    }
+
+    std::vector<int> cachePosition(vertexCount, -1);
+    std::vector<float> vertexScore(vertexCount), triangleScore(triangleCount, 0.0f);
+    std::vector<char> emitted(triangleCount, 0);
+
+    auto scoreVertex = [&](int v) {
+        if (valence[v] == 0) return -1.0f;
+
+        float score = 0.0f;
+        int position = cachePosition[v];
+        if (position >= 0) {
+            if (position < 3) {
+                // the last triangle's vertices, fixed score so we don't just keep using the same ones
+                score = lastTriangleScore;
+            } else {
+                score = std::pow(1.0f - (float)(position - 3) / (cacheSize - 3), cacheDecayPower);
+            }
+        }
+
+        return score + valenceBoostScale * std::pow((float)valence[v], -valenceBoostPower);
+    };
+
+    for (int v = 0; v < vertexCount; v++) vertexScore[v] = scoreVertex(v);
+    for (int t = 0; t < triangleCount; t++) {
+        for (int k = 0; k < 3; k++) triangleScore[t] += vertexScore[indices[t * 3 + k]];
+    }
+
+    std::vector<uint32_t> output;
+    output.reserve(indices.size());
+
+    std::vector<int> cache, nextCache, touched;
+    int bestTriangle = 0;
+    int scanPosition = 0;
+
+    for (int emittedCount = 0; emittedCount < triangleCount; emittedCount++) {
+        // nothing good in the cache, take the next triangle we haven't done yet
+        if (bestTriangle < 0) {
+            while (emitted[scanPosition]) scanPosition++;
+            bestTriangle = scanPosition;
+        }
+
+        int t = bestTriangle;
+        emitted[t] = 1;
+
+        // push the triangle's vertices to the front of the cache and take it off their lists
+        nextCache.clear();
+        for (int k = 0; k < 3; k++) {
+            int v = indices[t * 3 + k];
+            output.push_back(v);
+            nextCache.push_back(v);
+
+            int* begin = &vertexTriangles[offsets[v]];
+            int* end = begin + valence[v];
+            std::iter_swap(std::find(begin, end, t), end - 1);
+            valence[v]--;
+        }
+        for (int v : cache) {
+            if (v != (int)indices[t * 3] && v != (int)indices[t * 3 + 1] && v != (int)indices[t * 3 + 2]) {
+                nextCache.push_back(v);
+            }
+        }
+
+        // whatever got pushed out of the cache loses its cache score
+        for (size_t i = cacheSize; i < nextCache.size(); i++) {
+            cachePosition[nextCache[i]] = -1;
+        }
+        if ((int)nextCache.size() > cacheSize) nextCache.resize(cacheSize);
+        for (size_t i = 0; i < nextCache.size(); i++) cachePosition[nextCache[i]] = i;
+
+        // rescore everything that moved (the evicted vertices only matter if we ever come back to them)
+        touched.assign(nextCache.begin(), nextCache.end());
+        for (int v : cache) {
+            if (cachePosition[v] < 0) touched.push_back(v);
+        }
+        cache.swap(nextCache);
+
+        bestTriangle = -1;
+        float bestScore = -1.0f;
+        for (int v : touched) {
+            float score = scoreVertex(v);
+            float delta = score - vertexScore[v];
+            vertexScore[v] = score;
+
+            for (int i = 0; i < valence[v]; i++) {
+                int other = vertexTriangles[offsets[v] + i];
+                triangleScore[other] += delta;
+            }
+        }
+        for (int v : cache) {
+            for (int i = 0; i < valence[v]; i++) {
+                int other = vertexTriangles[offsets[v] + i];
+                if (triangleScore[other] > bestScore) {
+                    bestScore = triangleScore[other];
+                    bestTriangle = other;
+                }
+            }
+        }
+    }
+
+    indices.swap(output);
+}
+
+// builds a shared vertex mesh of the grid region [x0, x1] x [z0, z1] (vertex coordinates, inclusive)
+inline TerrainMesh buildTerrainMesh(const Heightmap& heights, const std::vector<uint8_t>& biomes, const BiomeTable& table,
+                                    int x0, int z0, int x1, int z1, MeshOrder order, const float lightSource[3]) {
+    TerrainMesh mesh;
+    mesh.x0 = x0;
+    mesh.z0 = z0;
+    mesh.x1 = x1;
+    mesh.z1 = z1;
+
+    int columns = z1 - z0 + 1;
+    int rows = x1 - x0 + 1;
+
+    mesh.updateHeights(heights, lightSource);
+    mesh.colorize(biomes, heights.depth, table);
+
+    auto vertex = [columns](int row, int column) { return (uint32_t)(row * columns + column); };
+
+    if (order == MESH_STRIPS) {
+        // each row of quads is one strip zig-zagging between row r and r + 1
+        // to jump to the next row we repeat the last vertex and the next first vertex, which makes
+        // degenerate (zero area) triangles the gpu throws away. that's 2 extra indices, so every row
+        // starts on an even index and keeps the same winding
+        mesh.primitive = GL_TRIANGLE_STRIP;
+        mesh.indices.reserve((size_t)(rows - 1) * (columns * 2 + 2));
+        for (int r = 0; r + 1 < rows; r++) {
+            if (r > 0) {
+                mesh.indices.push_back(mesh.indices.back());
+                mesh.indices.push_back(vertex(r, 0));
+            }
+
+            for (int c = 0; c < columns; c++) {
+                mesh.indices.push_back(vertex(r, c));
+                mesh.indices.push_back(vertex(r + 1, c));
+            }
+        }
+
+        return mesh;
+    }
+
+    // triangle list, split the same way as the lod chunks
+    mesh.primitive = GL_TRIANGLES;
+    mesh.indices.reserve((size_t)(rows - 1) * (columns - 1) * 6);
+    for (int r = 0; r + 1 < rows; r++) {
+        for (int c = 0; c + 1 < columns; c++) {
+            uint32_t v00 = vertex(r, c), v10 = vertex(r + 1, c), v11 = vertex(r + 1, c + 1), v01 = vertex(r, c + 1);
+            mesh.indices.insert(mesh.indices.end(), { v00, v10, v11, v00, v11, v01 });
+        }
+    }
+
+    if (order == MESH_FORSYTH) {
+        optimizeVertexCacheForsyth(mesh.indices, rows * columns);
+    }
+
+    return mesh;
+}
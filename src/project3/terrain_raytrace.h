@@ -0,0 +1,268 @@
+#pragma once
+
+#include <cmath>
+#include <cstdio>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include "heightmap.h"
+#include "biome.h"
+#include "parallel.h"
+#include "heightmap_pyramid.h"
+
+// cpu renderer for the terrain, so there's a picture of it without any opengl (thumbnails on headless machines)
+//
+// rays walk the heightmap pyramid: level 0 is every grid cell, each level above covers 2 x 2 nodes of the one
+// below and knows the highest height in them. a ray that stays above a node's max over the stretch
+// it spends in that node can skip the whole node, so most of the sky and the empty space over valleys gets
+// crossed in a few big steps and only the cells right where the ray hits get tested against triangles
+// (the same two triangles per cell the mesh draws, so the picture lines up with the opengl one)
+//
+// shading is the same as everywhere else: biome color of the height times the clamped diffuse term,
+// plus an optional shadow ray towards the light that uses the same walk
+
+struct RaytraceOptions {
+    int width = 640;
+    int height = 360;
+    float yaw = 0.0f;   // degrees around the terrain, 0 looks from +z like the opengl view
+    float pitch = 30.0f; // degrees down from the horizon, same as the opengl view's tilt
+    float fov = 45.0f;   // vertical, degrees
+    bool shadows = true;
+    int tileRows = 16;   // scanlines per work item
+    int threadCount = defaultThreadCount();
+};
+
+// ray against one of the triangles, t in [tMin, tMax]
+// doubles all the way through the tracer, on a 16k grid floats can't step from one cell to the next reliably
+inline bool intersectRaytraceTriangle(const double origin[3], const double direction[3], const double a[3], const double b[3], const double c[3],
+                                      double tMin, double tMax, double& t) {
+    double edge1[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+    double edge2[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+    double p[3] = {
+        direction[1] * edge2[2] - direction[2] * edge2[1],
+        direction[2] * edge2[0] - direction[0] * edge2[2],
+        direction[0] * edge2[1] - direction[1] * edge2[0]
+    };
+    double determinant = edge1[0] * p[0] + edge1[1] * p[1] + edge1[2] * p[2];
+    if (std::fabs(determinant) < 1e-12) return false;
+
+    double inverse = 1.0 / determinant;
+    double s[3] = { origin[0] - a[0], origin[1] - a[1], origin[2] - a[2] };
+    double u = (s[0] * p[0] + s[1] * p[1] + s[2] * p[2]) * inverse;
+    if (u < -1e-9 || u > 1.0 + 1e-9) return false;
+
+    double q[3] = { s[1] * edge1[2] - s[2] * edge1[1], s[2] * edge1[0] - s[0] * edge1[2], s[0] * edge1[1] - s[1] * edge1[0] };
+    double v = (direction[0] * q[0] + direction[1] * q[1] + direction[2] * q[2]) * inverse;
+    if (v < -1e-9 || u + v > 1.0 + 1e-9) return false;
+
+    t = (edge2[0] * q[0] + edge2[1] * q[1] + edge2[2] * q[2]) * inverse;
+    return t >= tMin && t <= tMax;
+}
+
+// first hit of the ray with the terrain, direction has to be normalized (t is then in grid cells)
+inline bool traceHeightfield(const Heightmap& heights, const HeightmapPyramid& pyramid, const double origin[3], const double direction[3],
+                             double tMax, double& hit) {
+    int top = pyramid.levels() - 1;
+
+    // clip the ray to the terrain's bounding box first
+    // (a little taller than the terrain, rays that hit flat ground at the lowest height would otherwise get clipped right at the hit)
+    double low[3] = { 0.0, pyramid.node(top, 0, 0).minimum - 1e-3, 0.0 };
+    double high[3] = { (double)heights.width - 1, pyramid.node(top, 0, 0).maximum + 1e-3, (double)heights.depth - 1 };
+    double t = 0.0, tEnd = tMax;
+    for (int k = 0; k < 3; k++) {
+        if (std::fabs(direction[k]) < 1e-12) {
+            if (origin[k] < low[k] || origin[k] > high[k]) return false;
+            continue;
+        }
+        double t0 = (low[k] - origin[k]) / direction[k], t1 = (high[k] - origin[k]) / direction[k];
+        t = std::max(t, std::min(t0, t1));
+        tEnd = std::min(tEnd, std::max(t0, t1));
+    }
+
+    const double nudge = 1e-6;
+    int level = top;
+    while (t <= tEnd) {
+        double x = origin[0] + direction[0] * t, z = origin[2] + direction[2] * t;
+        int size = 1 << level;
+        int cellX = std::min(std::max((int)std::floor(x / size), 0), pyramid.width(level) - 1);
+        int cellZ = std::min(std::max((int)std::floor(z / size), 0), pyramid.depth(level) - 1);
+
+        // where the ray leaves this node sideways
+        double x0 = (double)cellX * size, x1 = std::min(x0 + size, (double)heights.width - 1);
+        double z0 = (double)cellZ * size, z1 = std::min(z0 + size, (double)heights.depth - 1);
+        double exit = tEnd;
+        if (direction[0] > 0) exit = std::min(exit, (x1 - origin[0]) / direction[0]);
+        if (direction[0] < 0) exit = std::min(exit, (x0 - origin[0]) / direction[0]);
+        if (direction[2] > 0) exit = std::min(exit, (z1 - origin[2]) / direction[2]);
+        if (direction[2] < 0) exit = std::min(exit, (z0 - origin[2]) / direction[2]);
+        exit = std::max(exit, t);
+
+        // the ray is a straight line, so its lowest point in the node is at one of the ends
+        double lowest = origin[1] + direction[1] * (direction[1] < 0 ? exit : t);
+        if (lowest > pyramid.node(level, cellX, cellZ).maximum) {
+            t = exit + nudge;
+            if (level < top) level++;
+            continue;
+        }
+
+        if (level > 0) {
+            level--;
+            continue;
+        }
+
+        int gx = cellX, gz = cellZ;
+        int gx1 = std::min(gx + 1, heights.width - 1), gz1 = std::min(gz + 1, heights.depth - 1);
+        double v00[3] = { (double)gx, heights.get(gx, gz), (double)gz };
+        double v10[3] = { (double)gx1, heights.get(gx1, gz), (double)gz };
+        double v11[3] = { (double)gx1, heights.get(gx1, gz1), (double)gz1 };
+        double v01[3] = { (double)gx, heights.get(gx, gz1), (double)gz1 };
+
+        double first = INFINITY, candidate;
+        if (intersectRaytraceTriangle(origin, direction, v00, v10, v11, t - nudge, exit + nudge, candidate)) first = candidate;
+        if (intersectRaytraceTriangle(origin, direction, v00, v11, v01, t - nudge, exit + nudge, candidate)) first = std::min(first, candidate);
+        if (first < INFINITY) {
+            hit = first;
+            return true;
+        }
+
+        t = exit + nudge;
+    }
+
+    return false;
+}
+
+// renders the terrain into rgb (3 bytes per pixel, top row first)
+inline void raytraceTerrain(const Heightmap& heights, const HeightmapPyramid& pyramid, const BiomeTable& table, const float lightSource[3],
+                            const RaytraceOptions& options, std::vector<uint8_t>& rgb) {
+    rgb.assign((size_t)options.width * options.height * 3, 0);
+    if (heights.width < 2 || heights.depth < 2) return;
+
+    int top = pyramid.levels() - 1;
+    const double degrees = 3.14159265358979 / 180.0;
+
+    double halfHeight = std::tan(options.fov * 0.5 * degrees);
+    double halfWidth = halfHeight * options.width / options.height;
+
+    // orbit camera around the middle of the terrain, far enough back that the whole grid fits
+    // (sideways that's the grid's diagonal, up and down the grid seen at the pitch angle plus the height range)
+    double minY = pyramid.node(top, 0, 0).minimum, maxY = pyramid.node(top, 0, 0).maximum;
+    double center[3] = { (heights.width - 1) * 0.5, (minY + maxY) * 0.5, (heights.depth - 1) * 0.5 };
+    double radius = 0.5 * std::sqrt((double)heights.width * heights.width + (double)heights.depth * heights.depth);
+    double yaw = options.yaw * degrees, pitch = options.pitch * degrees;
+    double verticalExtent = radius * std::fabs(std::sin(pitch)) + (maxY - minY) * 0.5 * std::cos(pitch);
+    double distance = 1.1 * std::max(radius / halfWidth, verticalExtent / halfHeight) + radius * 0.75;
+    double eye[3] = {
+        center[0] + distance * std::sin(yaw) * std::cos(pitch),
+        center[1] + distance * std::sin(pitch),
+        center[2] + distance * std::cos(yaw) * std::cos(pitch)
+    };
+
+    auto normalize = [](double v[3]) {
+        double length = std::sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+        for (int k = 0; k < 3; k++) v[k] /= length;
+    };
+
+    double forward[3] = { center[0] - eye[0], center[1] - eye[1], center[2] - eye[2] };
+    normalize(forward);
+    double right[3] = { -forward[2], 0.0, forward[0] }; // forward x (0, 1, 0)
+    normalize(right);
+    double up[3] = {
+        right[1] * forward[2] - right[2] * forward[1],
+        right[2] * forward[0] - right[0] * forward[2],
+        right[0] * forward[1] - right[1] * forward[0]
+    };
+
+    double toLight[3] = { lightSource[0], lightSource[1], lightSource[2] };
+    normalize(toLight);
+
+    int tileRows = std::max(1, options.tileRows);
+    int tiles = (options.height + tileRows - 1) / tileRows;
+
+    parallelFor(tiles, options.threadCount, [&](int tile) {
+        for (int py = tile * tileRows; py < std::min(options.height, (tile + 1) * tileRows); py++) {
+            for (int px = 0; px < options.width; px++) {
+                double u = ((px + 0.5) / options.width * 2.0 - 1.0) * halfWidth;
+                double v = (1.0 - (py + 0.5) / options.height * 2.0) * halfHeight;
+                double direction[3];
+                for (int k = 0; k < 3; k++) direction[k] = forward[k] + right[k] * u + up[k] * v;
+                normalize(direction);
+
+                double t;
+                if (!traceHeightfield(heights, pyramid, eye, direction, INFINITY, t)) continue;
+
+                double hitX = eye[0] + direction[0] * t, hitZ = eye[2] + direction[2] * t;
+
+                // blend the normals and heights of the cell's corners so the shading is smooth across cells
+                int x0 = std::min(std::max((int)std::floor(hitX), 0), heights.width - 2);
+                int z0 = std::min(std::max((int)std::floor(hitZ), 0), heights.depth - 2);
+                float fx = (float)std::min(std::max(hitX - x0, 0.0), 1.0), fz = (float)std::min(std::max(hitZ - z0, 0.0), 1.0);
+
+                float normal[3] = { 0.0f, 0.0f, 0.0f }, height = 0.0f;
+                for (int corner = 0; corner < 4; corner++) {
+                    int cx = x0 + (corner & 1), cz = z0 + (corner >> 1);
+                    float weight = ((corner & 1) ? fx : 1.0f - fx) * ((corner >> 1) ? fz : 1.0f - fz);
+                    float n[3];
+                    calculateHeightmapNormalAt(heights, cx, cz, n[0], n[1], n[2]);
+                    for (int k = 0; k < 3; k++) normal[k] += n[k] * weight;
+                    height += heights.get(cx, cz) * weight;
+                }
+
+                float dot = normal[0] * lightSource[0] + normal[1] * lightSource[1] + normal[2] * lightSource[2];
+                float diffuse = std::max(0.2f, std::min(1.0f, dot));
+
+                if (options.shadows && diffuse > 0.2f) {
+                    double start[3] = { hitX, eye[1] + direction[1] * t + 0.01, hitZ };
+                    double shadowHit;
+                    if (traceHeightfield(heights, pyramid, start, toLight, INFINITY, shadowHit) && shadowHit > 0.05) diffuse = 0.2f;
+                }
+
+                const float* color = table.color(table.classify(height));
+                uint8_t* pixel = &rgb[((size_t)py * options.width + px) * 3];
+                for (int k = 0; k < 3; k++) {
+                    pixel[k] = (uint8_t)std::lround(std::min(1.0f, color[k] * diffuse) * 255.0f);
+                }
+            }
+        }
+    });
+}
+
+// 24 bit uncompressed bmp, rgb is top row first like raytraceTerrain makes it
+inline bool writeImageBmp(const std::string& path, int width, int height, const std::vector<uint8_t>& rgb) {
+    FILE* file = std::fopen(path.c_str(), "wb");
+    if (!file) return false;
+
+    uint32_t rowBytes = ((uint32_t)width * 3 + 3) & ~3u;
+    uint32_t imageBytes = rowBytes * height;
+
+    uint8_t header[54] = { 'B', 'M' };
+    auto put32 = [&](int offset, uint32_t value) {
+        for (int k = 0; k < 4; k++) header[offset + k] = (uint8_t)(value >> (k * 8));
+    };
+    put32(2, 54 + imageBytes); // file size
+    put32(10, 54);             // pixel data offset
+    put32(14, 40);             // info header size
+    put32(18, (uint32_t)width);
+    put32(22, (uint32_t)height);
+    header[26] = 1;            // planes
+    header[28] = 24;           // bits per pixel
+    put32(34, imageBytes);
+
+    bool ok = std::fwrite(header, 1, sizeof(header), file) == sizeof(header);
+
+    // bmp rows go bottom up and bgr
+    std::vector<uint8_t> row(rowBytes, 0);
+    for (int y = height - 1; ok && y >= 0; y--) {
+        const uint8_t* source = &rgb[(size_t)y * width * 3];
+        for (int x = 0; x < width; x++) {
+            row[x * 3] = source[x * 3 + 2];
+            row[x * 3 + 1] = source[x * 3 + 1];
+            row[x * 3 + 2] = source[x * 3];
+        }
+        ok = std::fwrite(row.data(), 1, rowBytes, file) == rowBytes;
+    }
+
+    ok = (std::fclose(file) == 0) && ok;
+    return ok;
+}
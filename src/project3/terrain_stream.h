@@ -0,0 +1,339 @@
+#pragma once
+
+#include <GLFW/glfw3.h>
+
+#include <vector>
+#include <unordered_map>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+
+#include "heightmap.h"
+#include "biome.h"
+#include "frustum.h"
+#include "terrain_generator.h"
+
+// streaming terrain for the infinite world
+// the world is cut into tileSize x tileSize tiles keyed by integer tile coordinates
+// worker threads generate + smooth tiles around the camera in the background and the render thread
+// only ever looks at tiles that are already finished, so it never waits on generation
+// each tile first gets a cheap coarse preview (every previewStep'th vertex) and then the full tile,
+// tiles that aren't ready at all are just skipped
+
+struct TileKey {
+    int tx, tz;
+
+    bool operator==(const TileKey& other) const {
+        return tx == other.tx && tz == other.tz;
+    }
+};
+
+struct TileKeyHash {
+    size_t operator()(const TileKey& key) const {
+        return (size_t)hashLattice(key.tx, key.tz, 0);
+    }
+};
+
+enum TileState {
+    TILE_QUEUED = 0,
+    TILE_PREVIEW = 1, // coarse heights are ready
+    TILE_READY = 2    // full resolution heights are ready
+};
+
+// one resolution of a tile, the bounds are for frustum culling
+struct TileLevel {
+    Heightmap heights;
+    float minY = 0.0f, maxY = 0.0f;
+
+    // only touched by the render thread, classified the first time the tile is drawn
+    // (and again whenever the biome table changes)
+    std::vector<uint8_t> biomes;
+    int biomeVersion = -1;
+};
+
+struct TerrainTile {
+    TileKey key;
+
+    // written by a worker before the state is bumped, read by the renderer after checking the state
+    TileLevel preview;
+    TileLevel full;
+    std::atomic<int> state { TILE_QUEUED };
+    std::atomic<bool> evicted { false };
+
+    uint64_t lastUsedFrame = 0;
+};
+
+class TerrainTileCache {
+    private:
+        struct Job {
+            std::shared_ptr<TerrainTile> tile;
+            int phase; // TILE_PREVIEW or TILE_READY, the state this job produces
+        };
+
+        int tileSize;
+        int previewStep;
+        int smoothingPasses;
+        uint32_t seed;
+        size_t memoryCap;
+
+        std::unordered_map<TileKey, std::shared_ptr<TerrainTile>, TileKeyHash> tiles;
+        size_t memoryUsed = 0; // only touched by the render thread
+
+        // job queue shared with the workers
+        std::mutex queueMutex;
+        std::condition_variable queueReady;
+        std::vector<Job> jobs;
+        TileKey focus = { 0, 0 };
+        bool stopping = false;
+
+        std::vector<std::thread> workers;
+        uint64_t frame = 0;
+
+        size_t tileBytes() const {
+            size_t full = (size_t)(tileSize + 1) * (tileSize + 1);
+            size_t coarse = (size_t)(tileSize / previewStep + 1) * (tileSize / previewStep + 1);
+            return (full + coarse) * sizeof(float);
+        }
+
+        static int64_t distanceSquared(TileKey a, TileKey b) {
+            int64_t dx = a.tx - b.tx, dz = a.tz - b.tz;
+            return dx * dx + dz * dz;
+        }
+
+        // previews first (so something shows up quickly), then closest to the camera first
+        bool takeJob(Job& job) {
+            std::unique_lock<std::mutex> lock(queueMutex);
+            queueReady.wait(lock, [this] { return stopping || !jobs.empty(); });
+            if (stopping) return false;
+
+            size_t best = 0;
+            for (size_t i = 1; i < jobs.size(); i++) {
+                const Job& a = jobs[i];
+                const Job& b = jobs[best];
+                if (a.phase != b.phase ? a.phase < b.phase : distanceSquared(a.tile->key, focus) < distanceSquared(b.tile->key, focus)) {
+                    best = i;
+                }
+            }
+
+            job = jobs[best];
+            jobs[best] = jobs.back();
+            jobs.pop_back();
+            return true;
+        }
+
+        void generate(TerrainTile& tile, TileLevel& level, int step) {
+            int vertices = tileSize / step + 1;
+            Heightmap& out = level.heights;
+            out.resize(vertices, vertices);
+
+            // generated with a halo so the smoothing matches up with the neighboring tiles (no seams)
+            generateSmoothedTerrainWindow(out, tile.key.tx * tileSize, tile.key.tz * tileSize, step, seed, smoothingPasses);
+
+            level.minY = 1e30f;
+            level.maxY = -1e30f;
+            for (int x = 0; x < out.width; x++) {
+                for (int z = 0; z < out.depth; z++) {
+                    level.minY = std::min(level.minY, out.get(x, z));
+                    level.maxY = std::max(level.maxY, out.get(x, z));
+                }
+            }
+        }
+
+        void workerLoop() {
+            Job job;
+            while (takeJob(job)) {
+                TerrainTile& tile = *job.tile;
+                if (tile.evicted.load()) continue;
+
+                if (job.phase == TILE_PREVIEW) {
+                    generate(tile, tile.preview, previewStep);
+                    tile.state.store(TILE_PREVIEW, std::memory_order_release);
+
+                    std::lock_guard<std::mutex> lock(queueMutex);
+                    jobs.push_back({ job.tile, TILE_READY });
+                    queueReady.notify_one();
+                } else {
+                    generate(tile, tile.full, 1);
+                    tile.state.store(TILE_READY, std::memory_order_release);
+                }
+            }
+        }
+
+        void evict() {
+            if (memoryUsed <= memoryCap) return;
+
+            // oldest first, and furthest away when they were used in the same frame
+            std::vector<std::shared_ptr<TerrainTile>> candidates;
+            for (auto& entry : tiles) {
+                if (entry.second->lastUsedFrame != frame) {
+                    candidates.push_back(entry.second);
+                }
+            }
+
+            std::sort(candidates.begin(), candidates.end(), [this](const std::shared_ptr<TerrainTile>& a, const std::shared_ptr<TerrainTile>& b) {
+                if (a->lastUsedFrame != b->lastUsedFrame) return a->lastUsedFrame < b->lastUsedFrame;
+                return distanceSquared(a->key, focus) > distanceSquared(b->key, focus);
+            });
+
+            for (auto& tile : candidates) {
+                if (memoryUsed <= memoryCap) break;
+
+                // a worker might still be holding it, it'll see the flag (or finish) and drop its reference
+                tile->evicted.store(true);
+                tiles.erase(tile->key);
+                memoryUsed -= tileBytes();
+            }
+
+            // don't leave evicted tiles sitting in the queue
+            std::lock_guard<std::mutex> lock(queueMutex);
+            jobs.erase(std::remove_if(jobs.begin(), jobs.end(), [](const Job& job) { return job.tile->evicted.load(); }), jobs.end());
+        }
+
+    public:
+        // stats for the window title
+        int readyTiles = 0;
+        int previewTiles = 0;
+        int pendingTiles = 0;
+
+        TerrainTileCache(int tileSize, int previewStep, int smoothingPasses, uint32_t seed, size_t memoryCap, int workerCount)
+            : tileSize(tileSize), previewStep(previewStep), smoothingPasses(smoothingPasses), seed(seed), memoryCap(memoryCap) {
+            for (int i = 0; i < std::max(1, workerCount); i++) {
+                workers.emplace_back(&TerrainTileCache::workerLoop, this);
+            }
+        }
+
+        ~TerrainTileCache() {
+            {
+                std::lock_guard<std::mutex> lock(queueMutex);
+                stopping = true;
+            }
+            queueReady.notify_all();
+
+            for (auto& worker : workers) {
+                worker.join();
+            }
+        }
+
+        int getTileSize() const { return tileSize; }
+        size_t getMemoryUsed() const { return memoryUsed; }
+        size_t getTileCount() const { return tiles.size(); }
+
+        // queues every tile within radius tiles of the camera's tile that we don't have yet
+        // and throws out old tiles once we're over the memory cap, never waits on the workers
+        void update(float cameraX, float cameraZ, int radius) {
+            frame++;
+
+            TileKey center = { (int)std::floor(cameraX / tileSize), (int)std::floor(cameraZ / tileSize) };
+
+            std::vector<std::shared_ptr<TerrainTile>> created;
+            for (int tx = center.tx - radius; tx <= center.tx + radius; tx++) {
+                for (int tz = center.tz - radius; tz <= center.tz + radius; tz++) {
+                    TileKey key = { tx, tz };
+                    auto found = tiles.find(key);
+                    if (found != tiles.end()) {
+                        found->second->lastUsedFrame = frame;
+                        continue;
+                    }
+
+                    auto tile = std::make_shared<TerrainTile>();
+                    tile->key = key;
+                    tile->lastUsedFrame = frame;
+                    tiles[key] = tile;
+                    memoryUsed += tileBytes();
+                    created.push_back(tile);
+                }
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(queueMutex);
+                focus = center;
+                for (auto& tile : created) {
+                    jobs.push_back({ tile, TILE_PREVIEW });
+                }
+            }
+            if (!created.empty()) {
+                queueReady.notify_all();
+            }
+
+            evict();
+        }
+
+        // draws whatever is ready, the current modelview should be in world space
+        void draw(const Frustum& frustum, const BiomeTable& biomeTable, const float lightSource[3]) {
+            readyTiles = previewTiles = pendingTiles = 0;
+
+            for (auto& entry : tiles) {
+                TerrainTile& tile = *entry.second;
+                int state = tile.state.load(std::memory_order_acquire);
+
+                if (state == TILE_QUEUED) {
+                    pendingTiles++;
+                    continue;
+                }
+
+                // not ready at full resolution yet, so draw the coarse preview instead
+                TileLevel& level = (state == TILE_READY) ? tile.full : tile.preview;
+                int step = (state == TILE_READY) ? 1 : previewStep;
+                if (state == TILE_READY) {
+                    readyTiles++;
+                } else {
+                    previewTiles++;
+                }
+
+                float originX = tile.key.tx * tileSize;
+                float originZ = tile.key.tz * tileSize;
+                if (!frustum.intersectsBox(originX, level.minY, originZ, originX + tileSize, level.maxY, originZ + tileSize)) {
+                    continue;
+                }
+
+                // a tile is small enough that spinning up threads would cost more than it saves
+                if (level.biomeVersion != biomeTable.version) {
+                    classifyBiomes(level.heights, biomeTable, level.biomes, 1);
+                    level.biomeVersion = biomeTable.version;
+                }
+
+                drawTile(level.heights, level.biomes, biomeTable, originX, originZ, step, lightSource);
+            }
+        }
+
+        static void drawTile(const Heightmap& heights, const std::vector<uint8_t>& biomes, const BiomeTable& biomeTable,
+                             float originX, float originZ, int step, const float lightSource[3]) {
+            glBegin(GL_TRIANGLES);
+            for (int x = 0; x + 1 < heights.width; x++) {
+                for (int z = 0; z + 1 < heights.depth; z++) {
+                    float h00 = heights.get(x, z);
+                    float h10 = heights.get(x + 1, z);
+                    float h11 = heights.get(x + 1, z + 1);
+                    float h01 = heights.get(x, z + 1);
+
+                    float normalX, normalY, normalZ;
+                    calculateHeightmapNormal(h00, h10, h01, (float)step, normalX, normalY, normalZ);
+
+                    float dot = (normalX * lightSource[0]) + (normalY * lightSource[1]) + (normalZ * lightSource[2]);
+                    float diffuse = std::max(0.2f, std::min(1.0f, dot));
+
+                    uint8_t b00 = biomes[x * heights.depth + z];
+                    uint8_t b10 = biomes[(x + 1) * heights.depth + z];
+                    uint8_t b11 = biomes[(x + 1) * heights.depth + z + 1];
+                    uint8_t b01 = biomes[x * heights.depth + z + 1];
+
+                    float x0 = originX + x * step, x1 = x0 + step;
+                    float z0 = originZ + z * step, z1 = z0 + step;
+
+                    biomeTable.setColor(b00, diffuse); glVertex3f(x0, h00, z0);
+                    biomeTable.setColor(b10, diffuse); glVertex3f(x1, h10, z0);
+                    biomeTable.setColor(b11, diffuse); glVertex3f(x1, h11, z1);
+
+                    biomeTable.setColor(b00, diffuse); glVertex3f(x0, h00, z0);
+                    biomeTable.setColor(b11, diffuse); glVertex3f(x1, h11, z1);
+                    biomeTable.setColor(b01, diffuse); glVertex3f(x0, h01, z1);
+                }
+            }
+            glEnd();
+        }
+};